@@ -26,14 +26,14 @@ if errorlevel 1 (
 )
 
 echo [3/4] Compiling demo (debug build)...
-C:\msys64\usr\bin\bash.exe -c "export PATH=/mingw64/bin:$PATH && cd /e/projects/64kdemo/vulkan-demo && gcc -std=c99 -Isrc -I/c/VulkanSDK/1.4.321.1/Include -I/mingw64/include -g -O0 -o build/Vulkan64KDemo_debug.exe src/main.c src/vulkan_setup.c src/shader_loader.c src/shadertoy_compat.c src/audio_synthesis.c src/sync_system.c -L/c/VulkanSDK/1.4.321.1/Lib -L/mingw64/lib -lvulkan-1 -lglfw3 -lwinmm -lgdi32 -luser32 -lkernel32 -static-libgcc"
+C:\msys64\usr\bin\bash.exe -c "export PATH=/mingw64/bin:$PATH && cd /e/projects/64kdemo/vulkan-demo && gcc -std=c99 -Isrc -I/c/VulkanSDK/1.4.321.1/Include -I/mingw64/include -g -O0 -o build/Vulkan64KDemo_debug.exe src/main.c src/vulkan_setup.c src/shader_loader.c src/shadertoy_compat.c src/audio_synthesis.c src/sync_system.c src/file_map.c src/audio_cache.c src/audio_fft.c src/audio_analysis.c src/platform.c src/audio_onset.c src/audio_limiter.c src/audio_sidechain.c src/audio_reverb.c src/audio_convolver.c src/audio_graph.c src/audio_resampler.c src/audio_oversampler.c src/sync_tracks.c src/sync_export.c src/sync_expr.c src/sync_record.c src/timeline.c src/audio_clock.c -L/c/VulkanSDK/1.4.321.1/Lib -L/mingw64/lib -lvulkan-1 -lglfw3 -lwinmm -lws2_32 -lgdi32 -luser32 -lkernel32 -static-libgcc"
 if errorlevel 1 (
     echo ERROR: Compilation failed
     exit /b 1
 )
 
 echo [4/4] Compiling demo (release build)...
-C:\msys64\usr\bin\bash.exe -c "export PATH=/mingw64/bin:$PATH && cd /e/projects/64kdemo/vulkan-demo && gcc -std=c99 -Isrc -I/c/VulkanSDK/1.4.321.1/Include -I/mingw64/include -Os -s -ffast-math -ffunction-sections -fdata-sections -o build/Vulkan64KDemo.exe src/main.c src/vulkan_setup.c src/shader_loader.c src/shadertoy_compat.c src/audio_synthesis.c src/sync_system.c -L/c/VulkanSDK/1.4.321.1/Lib -L/mingw64/lib -lvulkan-1 -lglfw3 -lwinmm -lgdi32 -luser32 -lkernel32 -static-libgcc -Wl,--gc-sections"
+C:\msys64\usr\bin\bash.exe -c "export PATH=/mingw64/bin:$PATH && cd /e/projects/64kdemo/vulkan-demo && gcc -std=c99 -Isrc -I/c/VulkanSDK/1.4.321.1/Include -I/mingw64/include -Os -s -ffast-math -ffunction-sections -fdata-sections -o build/Vulkan64KDemo.exe src/main.c src/vulkan_setup.c src/shader_loader.c src/shadertoy_compat.c src/audio_synthesis.c src/sync_system.c src/file_map.c src/audio_cache.c src/audio_fft.c src/audio_analysis.c src/platform.c src/audio_onset.c src/audio_limiter.c src/audio_sidechain.c src/audio_reverb.c src/audio_convolver.c src/audio_graph.c src/audio_resampler.c src/audio_oversampler.c src/sync_tracks.c src/sync_export.c src/sync_expr.c src/sync_record.c src/timeline.c src/audio_clock.c -L/c/VulkanSDK/1.4.321.1/Lib -L/mingw64/lib -lvulkan-1 -lglfw3 -lwinmm -lws2_32 -lgdi32 -luser32 -lkernel32 -static-libgcc -Wl,--gc-sections"
 if errorlevel 1 (
     echo ERROR: Release compilation failed
     exit /b 1
@@ -1,6 +1,6 @@
 @echo off
 echo Compiling Vulkan Demo...
-C:\msys64\mingw64\bin\gcc.exe -std=c99 -Isrc -IC:/VulkanSDK/1.4.321.1/Include -IC:/msys64/mingw64/include -g -O0 -o build/Vulkan64KDemo_debug.exe src/main.c src/vulkan_setup.c src/shader_loader.c src/shadertoy_compat.c src/audio_synthesis.c src/sync_system.c -LC:/VulkanSDK/1.4.321.1/Lib -LC:/msys64/mingw64/lib -lvulkan-1 -lglfw3 -lwinmm -lgdi32 -luser32 -lkernel32 -static-libgcc 1>build/compile.log 2>&1
+C:\msys64\mingw64\bin\gcc.exe -std=c99 -Isrc -IC:/VulkanSDK/1.4.321.1/Include -IC:/msys64/mingw64/include -g -O0 -o build/Vulkan64KDemo_debug.exe src/main.c src/vulkan_setup.c src/shader_loader.c src/shadertoy_compat.c src/audio_synthesis.c src/sync_system.c src/file_map.c src/audio_cache.c src/audio_fft.c src/audio_analysis.c src/platform.c src/audio_onset.c src/audio_limiter.c src/audio_sidechain.c src/audio_reverb.c src/audio_convolver.c src/audio_graph.c src/audio_resampler.c src/audio_oversampler.c src/sync_tracks.c src/sync_export.c src/sync_expr.c src/sync_record.c src/timeline.c src/audio_clock.c -LC:/VulkanSDK/1.4.321.1/Lib -LC:/msys64/mingw64/lib -lvulkan-1 -lglfw3 -lwinmm -lws2_32 -lgdi32 -luser32 -lkernel32 -static-libgcc 1>build/compile.log 2>&1
 echo.
 echo Exit code: %ERRORLEVEL%
 echo.
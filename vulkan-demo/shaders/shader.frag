@@ -2,7 +2,9 @@
 
 layout(location = 0) out vec4 outColor;
 
-layout(binding = 0) uniform UniformBufferObject {
+// Per-frame values, from the uniform buffer or, with DEMO_UNIFORMS=push,
+// from push constants. Track values always come from the uniform buffer.
+struct FrameUniforms {
     float iTime;
     vec2 iResolution;
     vec4 iMouse;
@@ -15,7 +17,30 @@ layout(binding = 0) uniform UniformBufferObject {
     float iIntensity;
     int iKick;
     int iSnare;
-} ubo;
+    // Triggers fired this frame, bit n for SyncTriggerKind n
+    uint iTriggers;
+    // Song position in beats, locked to the audio clock
+    float iBeat;
+};
+
+layout(binding = 0) uniform UniformBufferObject {
+    FrameUniforms frame;
+    // Sync track values, four handles per element (SYNC_UNIFORM_TRACKS / 4)
+    vec4 iTracks[8];
+} uniformBlock;
+
+layout(push_constant) uniform PushConstants {
+    FrameUniforms frame;
+} pushBlock;
+
+// Set at pipeline creation from DemoApp.pushConstants
+layout(constant_id = 0) const bool USE_PUSH_CONSTANTS = false;
+
+FrameUniforms ubo;
+
+// ShaderToy-style audio input: row 0 (v = 0.25) is the 512-bin spectrum,
+// row 1 (v = 0.75) the waveform
+layout(binding = 1) uniform sampler2D iChannel0;
 
 #define MAX_STEPS 128
 #define MAX_DIST 100.0
@@ -251,6 +276,9 @@ vec3 getSceneColor(vec3 p, vec3 rd, float d) {
         float starField = smoothstep(0.98, 1.0, noise(rd * 100.0));
         col = vec3(0.05, 0.05, 0.1) + starField * vec3(1.0, 0.9, 0.8);
         col += vec3(0.2, 0.1, 0.3) * (1.0 - rd.y) * 0.3;
+        
+        float fft = texture(iChannel0, vec2(abs(rd.x) * 0.5, 0.25)).r;
+        col += vec3(0.15, 0.25, 0.5) * fft * fft * smoothstep(0.4, -0.3, rd.y) * 0.5;
     }
     
     return col;
@@ -272,6 +300,11 @@ vec3 postProcess(vec3 col, vec2 uv) {
 }
 
 void main() {
+    if (USE_PUSH_CONSTANTS) {
+        ubo = pushBlock.frame;
+    } else {
+        ubo = uniformBlock.frame;
+    }
     vec2 uv = (gl_FragCoord.xy - 0.5 * ubo.iResolution.xy) / ubo.iResolution.y;
     
     vec3 col = vec3(0.0);
@@ -0,0 +1,93 @@
+#include "audio_analysis.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI 3.14159265359f
+
+// WebAudio AnalyserNode defaults, which is what ShaderToy feeds its shaders
+#define SPECTRUM_MIN_DB -100.0f
+#define SPECTRUM_MAX_DB -30.0f
+#define SPECTRUM_SMOOTHING 0.8f
+
+int audio_spectrum_init(AudioSpectrum* spectrum) {
+    memset(spectrum, 0, sizeof(*spectrum));
+    
+    if (fft_init(&spectrum->plan, AUDIO_FFT_SIZE) != 0) {
+        return -1;
+    }
+    
+    int half = AUDIO_FFT_SIZE / 2;
+    spectrum->window = malloc(AUDIO_FFT_SIZE * sizeof(float));
+    spectrum->frame = malloc(AUDIO_FFT_SIZE * sizeof(float));
+    spectrum->re = malloc((half + 1) * sizeof(float));
+    spectrum->im = malloc((half + 1) * sizeof(float));
+    
+    if (!spectrum->window || !spectrum->frame || !spectrum->re || !spectrum->im) {
+        audio_spectrum_free(spectrum);
+        return -1;
+    }
+    
+    for (int i = 0; i < AUDIO_FFT_SIZE; i++) {
+        float x = (float)i / (float)AUDIO_FFT_SIZE;
+        spectrum->window[i] = 0.42f - 0.5f * cosf(2.0f * PI * x) + 0.08f * cosf(4.0f * PI * x);
+    }
+    
+    memset(spectrum->texture[1], 128, AUDIO_SPECTRUM_BINS);
+    return 0;
+}
+
+void audio_spectrum_free(AudioSpectrum* spectrum) {
+    fft_free(&spectrum->plan);
+    free(spectrum->window);
+    free(spectrum->frame);
+    free(spectrum->re);
+    free(spectrum->im);
+    spectrum->window = NULL;
+    spectrum->frame = NULL;
+    spectrum->re = NULL;
+    spectrum->im = NULL;
+}
+
+static uint8_t to_byte(float v) {
+    if (v <= 0.0f) return 0;
+    if (v >= 1.0f) return 255;
+    return (uint8_t)(v * 255.0f);
+}
+
+void audio_spectrum_update(AudioSpectrum* spectrum, const float* ring, uint32_t write_pos) {
+    if (!spectrum->frame) {
+        return;
+    }
+    
+    // Copy out the newest FFT-size window. The callback may keep writing
+    // ahead of write_pos; the ring is large enough that those samples never
+    // land in the window being read.
+    uint32_t start = write_pos - AUDIO_FFT_SIZE;
+    for (int i = 0; i < AUDIO_FFT_SIZE; i++) {
+        float s = ring[(start + (uint32_t)i) & (AUDIO_RING_SIZE - 1)];
+        spectrum->frame[i] = s * spectrum->window[i];
+    }
+    
+    // Waveform row is the most recent 512 samples, unwindowed
+    for (int i = 0; i < AUDIO_SPECTRUM_BINS; i++) {
+        float s = ring[(write_pos - AUDIO_SPECTRUM_BINS + (uint32_t)i) & (AUDIO_RING_SIZE - 1)];
+        spectrum->texture[1][i] = to_byte(0.5f + 0.5f * s);
+    }
+    
+    fft_real_forward(&spectrum->plan, spectrum->frame, spectrum->re, spectrum->im);
+    
+    float scale = 1.0f / (float)AUDIO_FFT_SIZE;
+    float db_range = 1.0f / (SPECTRUM_MAX_DB - SPECTRUM_MIN_DB);
+    for (int k = 0; k < AUDIO_SPECTRUM_BINS; k++) {
+        float re = spectrum->re[k];
+        float im = spectrum->im[k];
+        float magnitude = sqrtf(re * re + im * im) * scale;
+        
+        float smoothed = SPECTRUM_SMOOTHING * spectrum->smoothed[k] + (1.0f - SPECTRUM_SMOOTHING) * magnitude;
+        spectrum->smoothed[k] = smoothed;
+        
+        float db = 20.0f * log10f(smoothed + 1e-12f);
+        spectrum->texture[0][k] = to_byte((db - SPECTRUM_MIN_DB) * db_range);
+    }
+}
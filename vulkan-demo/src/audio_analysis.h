@@ -0,0 +1,28 @@
+#ifndef AUDIO_ANALYSIS_H
+#define AUDIO_ANALYSIS_H
+
+#include <stdint.h>
+
+#include "audio_fft.h"
+
+// Matches ShaderToy's audio input: 512 spectrum bins in row 0 and 512
+// waveform samples in row 1, both 8-bit
+#define AUDIO_SPECTRUM_BINS 512
+#define AUDIO_FFT_SIZE 2048
+#define AUDIO_RING_SIZE 8192
+
+typedef struct {
+    FFTPlan plan;
+    float* window;
+    float* frame;
+    float* re;
+    float* im;
+    float smoothed[AUDIO_SPECTRUM_BINS];
+    uint8_t texture[2][AUDIO_SPECTRUM_BINS];
+} AudioSpectrum;
+
+int audio_spectrum_init(AudioSpectrum* spectrum);
+void audio_spectrum_free(AudioSpectrum* spectrum);
+void audio_spectrum_update(AudioSpectrum* spectrum, const float* ring, uint32_t write_pos);
+
+#endif
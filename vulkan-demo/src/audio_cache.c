@@ -0,0 +1,146 @@
+#include "audio_cache.h"
+#include <stdio.h>
+#include <string.h>
+
+#define AUDIO_CACHE_MAGIC 0x41343643u
+#define AUDIO_CACHE_VERSION 1
+
+// 64-byte header keeps the PCM payload aligned inside the mapping
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t song_hash;
+    uint64_t payload_hash;
+    uint32_t sample_rate;
+    uint32_t pcm_frames;
+    uint32_t env_frames;
+    uint32_t env_hop;
+    uint8_t reserved[24];
+} AudioCacheHeader;
+
+static size_t audio_cache_payload_size(uint32_t pcm_frames, uint32_t env_frames) {
+    return (size_t)pcm_frames * sizeof(float) +
+           (size_t)AUDIO_ENV_KIND_COUNT * AUDIO_STEM_COUNT * env_frames;
+}
+
+static uint64_t audio_cache_hash(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    size_t words = size / 4;
+    
+    // FNV-1a over 32-bit words so validating a full soundtrack stays in the
+    // low milliseconds; hashing PCM then envelopes equals hashing both at once
+    for (size_t i = 0; i < words; i++) {
+        uint32_t w;
+        memcpy(&w, bytes + i * 4, 4);
+        hash = (hash ^ w) * 0x100000001b3ULL;
+    }
+    for (size_t i = words * 4; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+int audio_cache_load(AudioEngine* engine, const char* filename, uint64_t song_hash) {
+    FileMapping mapping;
+    if (file_map_open(&mapping, filename) != 0) {
+        return -1;
+    }
+    
+    const AudioCacheHeader* header = mapping.data;
+    const char* reason = NULL;
+    
+    if (mapping.size < sizeof(AudioCacheHeader) ||
+        header->magic != AUDIO_CACHE_MAGIC || header->version != AUDIO_CACHE_VERSION) {
+        reason = "bad header";
+    } else if (header->song_hash != song_hash ||
+               header->sample_rate != (uint32_t)engine->sequencer.sample_rate ||
+               header->env_hop != AUDIO_ENV_HOP) {
+        reason = "stale";
+    } else if (header->pcm_frames == 0 || header->env_frames == 0 ||
+               mapping.size != sizeof(AudioCacheHeader) + audio_cache_payload_size(header->pcm_frames, header->env_frames)) {
+        reason = "truncated";
+    } else if (audio_cache_hash(song_hash, header + 1, mapping.size - sizeof(AudioCacheHeader)) != header->payload_hash) {
+        reason = "corrupt";
+    }
+    
+    if (reason) {
+        fprintf(stderr, "Audio cache %s is %s, rebuilding\n", filename, reason);
+        file_map_close(&mapping);
+        return -1;
+    }
+    
+    audio_release_song(engine);
+    
+    const uint8_t* payload = (const uint8_t*)(header + 1);
+    engine->cache_mapping = mapping;
+    engine->pcm = (const float*)payload;
+    engine->pcm_frames = header->pcm_frames;
+    engine->play_frame = 0;
+    engine->envelopes.values = payload + (size_t)header->pcm_frames * sizeof(float);
+    engine->envelopes.frame_count = header->env_frames;
+    engine->envelopes.frame_rate = engine->sequencer.sample_rate / (float)AUDIO_ENV_HOP;
+    return 0;
+}
+
+int audio_cache_store(const AudioEngine* engine, const char* filename, uint64_t song_hash) {
+    if (!engine->pcm || !engine->envelopes.values) {
+        return -1;
+    }
+    
+    size_t pcm_size = (size_t)engine->pcm_frames * sizeof(float);
+    size_t env_size = audio_cache_payload_size(0, engine->envelopes.frame_count);
+    
+    AudioCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = AUDIO_CACHE_MAGIC;
+    header.version = AUDIO_CACHE_VERSION;
+    header.song_hash = song_hash;
+    header.sample_rate = (uint32_t)engine->sequencer.sample_rate;
+    header.pcm_frames = engine->pcm_frames;
+    header.env_frames = engine->envelopes.frame_count;
+    header.env_hop = AUDIO_ENV_HOP;
+    
+    uint64_t hash = audio_cache_hash(song_hash, engine->pcm, pcm_size);
+    header.payload_hash = audio_cache_hash(hash, engine->envelopes.values, env_size);
+    
+    char temp_name[512];
+    snprintf(temp_name, sizeof(temp_name), "%s.tmp", filename);
+    
+    FILE* file = fopen(temp_name, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to write audio cache: %s\n", temp_name);
+        return -1;
+    }
+    
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(engine->pcm, 1, pcm_size, file) == pcm_size &&
+              fwrite(engine->envelopes.values, 1, env_size, file) == env_size;
+    ok = (fclose(file) == 0) && ok;
+    
+    // Write-then-rename so a crash mid-write never leaves a half cache behind
+    if (!ok || file_replace(temp_name, filename) != 0) {
+        fprintf(stderr, "Failed to write audio cache: %s\n", filename);
+        remove(temp_name);
+        return -1;
+    }
+    
+    return 0;
+}
+
+int audio_precalc_cached(AudioEngine* engine, const char* filename, float seconds) {
+    uint64_t song_hash = audio_song_hash(engine, seconds);
+    
+    if (audio_cache_load(engine, filename, song_hash) == 0) {
+        printf("Loaded soundtrack from cache: %s\n", filename);
+        return 0;
+    }
+    
+    if (audio_precalc(engine, seconds) != 0) {
+        return -1;
+    }
+    
+    if (audio_cache_store(engine, filename, song_hash) == 0) {
+        printf("Stored soundtrack cache: %s\n", filename);
+    }
+    return 0;
+}
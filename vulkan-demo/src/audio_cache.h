@@ -0,0 +1,12 @@
+#ifndef AUDIO_CACHE_H
+#define AUDIO_CACHE_H
+
+#include "audio_synthesis.h"
+
+#define AUDIO_CACHE_FILE "soundtrack.cache"
+
+int audio_cache_load(AudioEngine* engine, const char* filename, uint64_t song_hash);
+int audio_cache_store(const AudioEngine* engine, const char* filename, uint64_t song_hash);
+int audio_precalc_cached(AudioEngine* engine, const char* filename, float seconds);
+
+#endif
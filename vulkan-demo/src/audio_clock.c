@@ -0,0 +1,88 @@
+#include "audio_clock.h"
+#include "platform.h"
+#include <math.h>
+#include <string.h>
+
+// Loop noise bandwidth in Hz, wide while acquiring lock and narrow after
+#define AUDIO_CLOCK_LOCK_BANDWIDTH 2.0
+#define AUDIO_CLOCK_BANDWIDTH 0.1
+#define AUDIO_CLOCK_SETTLE 32
+// Errors beyond this are a seek, wrap or dropout rather than jitter; the
+// loop starts over from the sample
+#define AUDIO_CLOCK_RESYNC 0.05
+// Reads stop extrapolating this long after the last callback
+#define AUDIO_CLOCK_HOLD 0.25
+
+void audio_clock_reset(AudioClock* clock) {
+    memset(clock, 0, sizeof(*clock));
+    clock->rate = 1.0;
+}
+
+// Audio thread, once per callback
+void audio_clock_publish(AudioClock* clock, double host, double audio) {
+    uint32_t count = clock->sample_count;
+    clock->samples[count % AUDIO_CLOCK_SLOTS].host = host;
+    clock->samples[count % AUDIO_CLOCK_SLOTS].audio = audio;
+    atomic_store_u32(&clock->sample_count, count + 1);
+}
+
+static void audio_clock_seed(AudioClock* clock, const AudioClockSample* sample) {
+    clock->locked = true;
+    clock->updates = 0;
+    clock->host_base = sample->host;
+    clock->audio_base = sample->audio;
+    clock->rate = 1.0;
+    clock->last = sample->audio;
+}
+
+// One step of the loop: the phase error pulls the fitted position by
+// sqrt(2) * omega and the rate by omega^2, for a critically damped
+// response at the loop bandwidth
+static void audio_clock_update(AudioClock* clock, const AudioClockSample* sample) {
+    if (!clock->locked) {
+        audio_clock_seed(clock, sample);
+        return;
+    }
+    
+    double dt = sample->host - clock->host_base;
+    if (dt <= 0.0) {
+        return;
+    }
+    double predicted = clock->audio_base + dt * clock->rate;
+    double error = sample->audio - predicted;
+    if (fabs(error) > AUDIO_CLOCK_RESYNC) {
+        audio_clock_seed(clock, sample);
+        return;
+    }
+    
+    double bandwidth = (clock->updates < AUDIO_CLOCK_SETTLE) ? AUDIO_CLOCK_LOCK_BANDWIDTH : AUDIO_CLOCK_BANDWIDTH;
+    double omega = fmin(2.0 * 3.14159265358979 * bandwidth * dt, 0.7);
+    clock->audio_base = predicted + 1.41421356 * omega * error;
+    clock->host_base = sample->host;
+    clock->rate += omega * omega * error / dt;
+    clock->updates++;
+}
+
+// Render thread. Feeds the loop every sample published since the last
+// read, then returns the fitted position at host. False until the first
+// callback has been seen.
+bool audio_clock_read(AudioClock* clock, double host, double* audio) {
+    uint32_t count = atomic_load_u32(&clock->sample_count);
+    
+    // Leave the slot the audio thread writes next alone
+    if (count - clock->seen > AUDIO_CLOCK_SLOTS - 1) {
+        clock->seen = count - (AUDIO_CLOCK_SLOTS - 1);
+    }
+    while (clock->seen != count) {
+        audio_clock_update(clock, &clock->samples[clock->seen % AUDIO_CLOCK_SLOTS]);
+        clock->seen++;
+    }
+    if (!clock->locked) {
+        return false;
+    }
+    
+    double elapsed = fmin(host - clock->host_base, AUDIO_CLOCK_HOLD);
+    clock->last = fmax(clock->audio_base + elapsed * clock->rate, clock->last);
+    *audio = clock->last;
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef AUDIO_CLOCK_H
+#define AUDIO_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Power of two; callbacks the reader may fall behind by
+#define AUDIO_CLOCK_SLOTS 8
+
+// Audible song time at a host time (platform_time_seconds())
+typedef struct {
+    double host;
+    double audio;
+} AudioClockSample;
+
+// Continuous audio position for the render thread. The audio callback
+// publishes one sample per buffer, so the raw position advances in
+// buffer-sized steps with scheduling jitter on top. A second-order
+// delay-locked loop fits a position and rate to the samples; reads
+// extrapolate the fit to the current host time and never go backwards.
+typedef struct {
+    // Written by the audio thread; sample_count only ever increases
+    AudioClockSample samples[AUDIO_CLOCK_SLOTS];
+    volatile uint32_t sample_count;
+    // Loop state, owned by the reader
+    uint32_t seen;
+    uint32_t updates;
+    bool locked;
+    double host_base;
+    double audio_base;
+    double rate;
+    double last;
+} AudioClock;
+
+void audio_clock_reset(AudioClock* clock);
+void audio_clock_publish(AudioClock* clock, double host, double audio);
+bool audio_clock_read(AudioClock* clock, double host, double* audio);
+
+#endif
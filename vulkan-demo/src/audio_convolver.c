@@ -0,0 +1,191 @@
+#include "audio_convolver.h"
+#include "audio_simd.h"
+#include "platform.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+static float* convolver_alloc(size_t count) {
+    float* data = platform_aligned_alloc(count * sizeof(float), 16);
+    if (data) {
+        memset(data, 0, count * sizeof(float));
+    }
+    return data;
+}
+
+int audio_convolver_init(AudioConvolver* conv, const float* ir, uint32_t ir_length, float wet) {
+    uint32_t partitions = (ir_length + CONVOLVER_BLOCK - 1) / CONVOLVER_BLOCK;
+    size_t spectra = (size_t)partitions * CONVOLVER_STRIDE;
+    
+    memset(conv, 0, sizeof(*conv));
+    if (partitions == 0 || fft_init(&conv->plan, CONVOLVER_FFT_SIZE) != 0) {
+        fprintf(stderr, "Failed to create convolver FFT plan\n");
+        return -1;
+    }
+    
+    conv->ir_re = convolver_alloc(spectra);
+    conv->ir_im = convolver_alloc(spectra);
+    conv->fdl_re = convolver_alloc(spectra);
+    conv->fdl_im = convolver_alloc(spectra);
+    conv->acc_re = convolver_alloc(CONVOLVER_STRIDE);
+    conv->acc_im = convolver_alloc(CONVOLVER_STRIDE);
+    if (!conv->ir_re || !conv->ir_im || !conv->fdl_re || !conv->fdl_im || !conv->acc_re || !conv->acc_im) {
+        fprintf(stderr, "Failed to allocate %u convolver partitions\n", partitions);
+        audio_convolver_free(conv);
+        return -1;
+    }
+    
+    // Each partition is zero-padded to the FFT size, which makes the
+    // circular products in process() linear over the saved half
+    float frame[CONVOLVER_FFT_SIZE];
+    for (uint32_t p = 0; p < partitions; p++) {
+        uint32_t offset = p * CONVOLVER_BLOCK;
+        uint32_t count = (ir_length - offset < CONVOLVER_BLOCK) ? ir_length - offset : CONVOLVER_BLOCK;
+        
+        memset(frame, 0, sizeof(frame));
+        memcpy(frame, ir + offset, count * sizeof(float));
+        fft_real_forward(&conv->plan, frame, conv->ir_re + p * CONVOLVER_STRIDE, conv->ir_im + p * CONVOLVER_STRIDE);
+    }
+    
+    conv->partitions = partitions;
+    conv->active = partitions;
+    conv->wet = wet;
+    audio_convolver_clear(conv);
+    return 0;
+}
+
+void audio_convolver_free(AudioConvolver* conv) {
+    fft_free(&conv->plan);
+    platform_aligned_free(conv->ir_re);
+    platform_aligned_free(conv->ir_im);
+    platform_aligned_free(conv->fdl_re);
+    platform_aligned_free(conv->fdl_im);
+    platform_aligned_free(conv->acc_re);
+    platform_aligned_free(conv->acc_im);
+    conv->ir_re = NULL;
+    conv->ir_im = NULL;
+    conv->fdl_re = NULL;
+    conv->fdl_im = NULL;
+    conv->acc_re = NULL;
+    conv->acc_im = NULL;
+    conv->partitions = 0;
+    conv->active = 0;
+}
+
+void audio_convolver_clear(AudioConvolver* conv) {
+    if (conv->fdl_re) {
+        memset(conv->fdl_re, 0, (size_t)conv->partitions * CONVOLVER_STRIDE * sizeof(float));
+        memset(conv->fdl_im, 0, (size_t)conv->partitions * CONVOLVER_STRIDE * sizeof(float));
+    }
+    memset(conv->input, 0, sizeof(conv->input));
+    memset(conv->output, 0, sizeof(conv->output));
+    conv->fdl_pos = 0;
+    conv->fill = 0;
+}
+
+// acc += x * h over one partition's bins
+static void convolver_cmac(float* acc_re, float* acc_im, const float* x_re, const float* x_im, const float* h_re, const float* h_im) {
+#ifdef AUDIO_SIMD_SSE
+    for (int k = 0; k < CONVOLVER_STRIDE; k += 4) {
+        __m128 xr = _mm_load_ps(x_re + k);
+        __m128 xi = _mm_load_ps(x_im + k);
+        __m128 hr = _mm_load_ps(h_re + k);
+        __m128 hi = _mm_load_ps(h_im + k);
+        __m128 re = _mm_sub_ps(_mm_mul_ps(xr, hr), _mm_mul_ps(xi, hi));
+        __m128 im = _mm_add_ps(_mm_mul_ps(xr, hi), _mm_mul_ps(xi, hr));
+        _mm_store_ps(acc_re + k, _mm_add_ps(_mm_load_ps(acc_re + k), re));
+        _mm_store_ps(acc_im + k, _mm_add_ps(_mm_load_ps(acc_im + k), im));
+    }
+#else
+    for (int k = 0; k < CONVOLVER_STRIDE; k++) {
+        acc_re[k] += x_re[k] * h_re[k] - x_im[k] * h_im[k];
+        acc_im[k] += x_re[k] * h_im[k] + x_im[k] * h_re[k];
+    }
+#endif
+}
+
+static void convolver_block(AudioConvolver* conv) {
+    uint32_t partitions = conv->partitions;
+    uint32_t active = conv->active;
+    uint32_t slot = conv->fdl_pos;
+    
+    fft_real_forward(&conv->plan, conv->input, conv->fdl_re + slot * CONVOLVER_STRIDE, conv->fdl_im + slot * CONVOLVER_STRIDE);
+    
+    memset(conv->acc_re, 0, CONVOLVER_STRIDE * sizeof(float));
+    memset(conv->acc_im, 0, CONVOLVER_STRIDE * sizeof(float));
+    
+    // Newest input spectrum against the first IR partition, walking back
+    // through the delay line for the later ones
+    for (uint32_t p = 0; p < active; p++) {
+        size_t x = (size_t)slot * CONVOLVER_STRIDE;
+        size_t h = (size_t)p * CONVOLVER_STRIDE;
+        convolver_cmac(conv->acc_re, conv->acc_im, conv->fdl_re + x, conv->fdl_im + x, conv->ir_re + h, conv->ir_im + h);
+        slot = (slot == 0) ? partitions - 1 : slot - 1;
+    }
+    
+    conv->fdl_pos = (conv->fdl_pos + 1 == partitions) ? 0 : conv->fdl_pos + 1;
+    
+    // Overlap-save: only the second half of the inverse is alias-free
+    fft_real_inverse(&conv->plan, conv->acc_re, conv->acc_im, conv->output);
+    memmove(conv->input, conv->input + CONVOLVER_BLOCK, CONVOLVER_BLOCK * sizeof(float));
+}
+
+void audio_convolver_process(AudioConvolver* conv, const float* input, float* output, uint32_t count) {
+    if (!conv->partitions) {
+        if (output != input) {
+            memmove(output, input, count * sizeof(float));
+        }
+        return;
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        float x = input[i];
+        conv->input[CONVOLVER_BLOCK + conv->fill] = x;
+        output[i] = x + conv->output[CONVOLVER_BLOCK + conv->fill] * conv->wet;
+        
+        if (++conv->fill == CONVOLVER_BLOCK) {
+            convolver_block(conv);
+            conv->fill = 0;
+        }
+    }
+}
+
+// Keeps the first fraction of the impulse response, at least one partition
+void audio_convolver_set_tail(AudioConvolver* conv, float fraction) {
+    uint32_t active = (uint32_t)(fraction * (float)conv->partitions + 0.5f);
+    if (active < 1) active = 1;
+    if (active > conv->partitions) active = conv->partitions;
+    conv->active = active;
+}
+
+// Procedural hall: exponentially decaying noise that darkens as it decays,
+// faded in over the first few milliseconds and normalized to unit energy
+void audio_convolver_make_hall(float* ir, uint32_t length, float sample_rate, float decay_seconds) {
+    uint32_t seed = 0x9e3779b9u;
+    uint32_t fade = (uint32_t)(0.005f * sample_rate);
+    float decay = -6.9078f / (decay_seconds * sample_rate);
+    float state = 0.0f;
+    double energy = 0.0;
+    
+    for (uint32_t n = 0; n < length; n++) {
+        seed = seed * 1664525u + 1013904223u;
+        float noise = (float)(seed >> 8) * (2.0f / 16777216.0f) - 1.0f;
+        float t = (float)n / (float)length;
+        
+        // Lowpass coefficient slides from open to dark over the tail
+        float coef = 0.9f - 0.75f * t;
+        state += coef * (noise - state);
+        
+        float value = state * expf(decay * (float)n);
+        if (n < fade) {
+            value *= (float)n / (float)fade;
+        }
+        ir[n] = value;
+        energy += (double)value * value;
+    }
+    
+    float scale = (energy > 0.0) ? (float)(1.0 / sqrt(energy)) : 0.0f;
+    for (uint32_t n = 0; n < length; n++) {
+        ir[n] *= scale;
+    }
+}
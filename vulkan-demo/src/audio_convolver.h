@@ -0,0 +1,46 @@
+#ifndef AUDIO_CONVOLVER_H
+#define AUDIO_CONVOLVER_H
+
+#include <stdint.h>
+
+#include "audio_fft.h"
+
+// Partition length and latency. CONVOLVER_BLOCK must be a power of 4 so the
+// 2 * CONVOLVER_BLOCK real FFT maps onto the radix-4 plan.
+#define CONVOLVER_BLOCK 256
+#define CONVOLVER_FFT_SIZE (CONVOLVER_BLOCK * 2)
+#define CONVOLVER_BINS (CONVOLVER_BLOCK + 1)
+// Bins padded to a whole number of SIMD vectors; the padding stays zero
+#define CONVOLVER_STRIDE ((CONVOLVER_BINS + 3) & ~3)
+
+// Uniformly partitioned overlap-save convolution. The impulse response is
+// cut into CONVOLVER_BLOCK-long partitions whose spectra sit next to the
+// frequency-domain delay line of input spectra, all in 16-byte aligned
+// [partition][bin] arrays. The wet signal lags the input by one block.
+// Only the first active partitions are convolved, which truncates the tail
+// without touching the delay line.
+typedef struct {
+    FFTPlan plan;
+    uint32_t partitions;
+    uint32_t active;
+    float* ir_re;
+    float* ir_im;
+    float* fdl_re;
+    float* fdl_im;
+    float* acc_re;
+    float* acc_im;
+    uint32_t fdl_pos;
+    uint32_t fill;
+    float wet;
+    float input[CONVOLVER_FFT_SIZE];
+    float output[CONVOLVER_FFT_SIZE];
+} AudioConvolver;
+
+int audio_convolver_init(AudioConvolver* conv, const float* ir, uint32_t ir_length, float wet);
+void audio_convolver_free(AudioConvolver* conv);
+void audio_convolver_clear(AudioConvolver* conv);
+void audio_convolver_process(AudioConvolver* conv, const float* input, float* output, uint32_t count);
+void audio_convolver_set_tail(AudioConvolver* conv, float fraction);
+void audio_convolver_make_hall(float* ir, uint32_t length, float sample_rate, float decay_seconds);
+
+#endif
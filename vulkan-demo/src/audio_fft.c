@@ -0,0 +1,196 @@
+#include "audio_fft.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define PI 3.14159265359f
+
+int fft_init(FFTPlan* plan, int real_size) {
+    int n = real_size / 2;
+    int digits = 0;
+    
+    while ((1 << (2 * digits)) < n) {
+        digits++;
+    }
+    if (n < 4 || (1 << (2 * digits)) != n) {
+        return -1;
+    }
+    
+    plan->n = n;
+    plan->cos_table = malloc(n * sizeof(float));
+    plan->sin_table = malloc(n * sizeof(float));
+    plan->real_cos = malloc((n + 1) * sizeof(float));
+    plan->real_sin = malloc((n + 1) * sizeof(float));
+    plan->reverse = malloc(n * sizeof(uint32_t));
+    plan->work_re = malloc(n * sizeof(float));
+    plan->work_im = malloc(n * sizeof(float));
+    
+    if (!plan->cos_table || !plan->sin_table || !plan->real_cos || !plan->real_sin ||
+        !plan->reverse || !plan->work_re || !plan->work_im) {
+        fft_free(plan);
+        return -1;
+    }
+    
+    for (int i = 0; i < n; i++) {
+        plan->cos_table[i] = cosf(2.0f * PI * (float)i / (float)n);
+        plan->sin_table[i] = -sinf(2.0f * PI * (float)i / (float)n);
+        
+        // Base-4 digit reversal undoes the decimation-in-frequency ordering
+        uint32_t r = 0;
+        uint32_t v = (uint32_t)i;
+        for (int d = 0; d < digits; d++) {
+            r = (r << 2) | (v & 3);
+            v >>= 2;
+        }
+        plan->reverse[i] = r;
+    }
+    
+    for (int k = 0; k <= n; k++) {
+        plan->real_cos[k] = cosf(PI * (float)k / (float)n);
+        plan->real_sin[k] = -sinf(PI * (float)k / (float)n);
+    }
+    
+    return 0;
+}
+
+void fft_free(FFTPlan* plan) {
+    free(plan->cos_table);
+    free(plan->sin_table);
+    free(plan->real_cos);
+    free(plan->real_sin);
+    free(plan->reverse);
+    free(plan->work_re);
+    free(plan->work_im);
+    plan->cos_table = NULL;
+    plan->sin_table = NULL;
+    plan->real_cos = NULL;
+    plan->real_sin = NULL;
+    plan->reverse = NULL;
+    plan->work_re = NULL;
+    plan->work_im = NULL;
+    plan->n = 0;
+}
+
+static void fft_radix4(const FFTPlan* plan, float* re, float* im) {
+    int n = plan->n;
+    
+    for (int span = n; span >= 4; span >>= 2) {
+        int quarter = span >> 2;
+        int stride = n / span;
+        
+        for (int base = 0; base < n; base += span) {
+            for (int j = 0; j < quarter; j++) {
+                int i0 = base + j;
+                int i1 = i0 + quarter;
+                int i2 = i1 + quarter;
+                int i3 = i2 + quarter;
+                
+                float t0r = re[i0] + re[i2], t0i = im[i0] + im[i2];
+                float t1r = re[i0] - re[i2], t1i = im[i0] - im[i2];
+                float t2r = re[i1] + re[i3], t2i = im[i1] + im[i3];
+                // (x1 - x3) * -i
+                float t3r = im[i1] - im[i3], t3i = re[i3] - re[i1];
+                
+                float y1r = t1r + t3r, y1i = t1i + t3i;
+                float y2r = t0r - t2r, y2i = t0i - t2i;
+                float y3r = t1r - t3r, y3i = t1i - t3i;
+                
+                re[i0] = t0r + t2r;
+                im[i0] = t0i + t2i;
+                
+                if (j == 0) {
+                    re[i1] = y1r; im[i1] = y1i;
+                    re[i2] = y2r; im[i2] = y2i;
+                    re[i3] = y3r; im[i3] = y3i;
+                    continue;
+                }
+                
+                int w1 = j * stride;
+                int w2 = 2 * w1;
+                int w3 = 3 * w1;
+                float c1 = plan->cos_table[w1], s1 = plan->sin_table[w1];
+                float c2 = plan->cos_table[w2], s2 = plan->sin_table[w2];
+                float c3 = plan->cos_table[w3], s3 = plan->sin_table[w3];
+                
+                re[i1] = y1r * c1 - y1i * s1; im[i1] = y1r * s1 + y1i * c1;
+                re[i2] = y2r * c2 - y2i * s2; im[i2] = y2r * s2 + y2i * c2;
+                re[i3] = y3r * c3 - y3i * s3; im[i3] = y3r * s3 + y3i * c3;
+            }
+        }
+    }
+    
+    for (int i = 0; i < n; i++) {
+        uint32_t r = plan->reverse[i];
+        if (r > (uint32_t)i) {
+            float tr = re[i], ti = im[i];
+            re[i] = re[r]; im[i] = im[r];
+            re[r] = tr; im[r] = ti;
+        }
+    }
+}
+
+void fft_complex(const FFTPlan* plan, float* re, float* im, int inverse) {
+    // The inverse transform is the forward one with real and imaginary swapped
+    if (inverse) {
+        fft_radix4(plan, im, re);
+    } else {
+        fft_radix4(plan, re, im);
+    }
+}
+
+void fft_real_forward(const FFTPlan* plan, const float* input, float* re, float* im) {
+    int n = plan->n;
+    float* zr = plan->work_re;
+    float* zi = plan->work_im;
+    
+    for (int i = 0; i < n; i++) {
+        zr[i] = input[2 * i];
+        zi[i] = input[2 * i + 1];
+    }
+    
+    fft_radix4(plan, zr, zi);
+    
+    for (int k = 0; k <= n; k++) {
+        int a = (k == n) ? 0 : k;
+        int b = (k == 0) ? 0 : n - k;
+        
+        float er = 0.5f * (zr[a] + zr[b]);
+        float ei = 0.5f * (zi[a] - zi[b]);
+        float or_ = 0.5f * (zi[a] + zi[b]);
+        float oi = -0.5f * (zr[a] - zr[b]);
+        
+        float c = plan->real_cos[k], s = plan->real_sin[k];
+        re[k] = er + or_ * c - oi * s;
+        im[k] = ei + or_ * s + oi * c;
+    }
+}
+
+void fft_real_inverse(const FFTPlan* plan, const float* re, const float* im, float* output) {
+    int n = plan->n;
+    float* zr = plan->work_re;
+    float* zi = plan->work_im;
+    
+    for (int k = 0; k < n; k++) {
+        int b = n - k;
+        
+        float er = 0.5f * (re[k] + re[b]);
+        float ei = 0.5f * (im[k] - im[b]);
+        float dr = 0.5f * (re[k] - re[b]);
+        float di = 0.5f * (im[k] + im[b]);
+        
+        // Odd half: difference rotated back by the conjugate twiddle
+        float c = plan->real_cos[k], s = -plan->real_sin[k];
+        float or_ = dr * c - di * s;
+        float oi = dr * s + di * c;
+        
+        zr[k] = er - oi;
+        zi[k] = ei + or_;
+    }
+    
+    fft_complex(plan, zr, zi, 1);
+    
+    float scale = 1.0f / (float)n;
+    for (int i = 0; i < n; i++) {
+        output[2 * i] = zr[i] * scale;
+        output[2 * i + 1] = zi[i] * scale;
+    }
+}
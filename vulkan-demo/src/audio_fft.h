@@ -0,0 +1,25 @@
+#ifndef AUDIO_FFT_H
+#define AUDIO_FFT_H
+
+#include <stdint.h>
+
+// Radix-4 FFT on split (SoA) complex data. A plan for real_size samples runs
+// a complex transform of real_size / 2 points, which must be a power of 4.
+typedef struct {
+    int n;
+    float* cos_table;
+    float* sin_table;
+    float* real_cos;
+    float* real_sin;
+    uint32_t* reverse;
+    float* work_re;
+    float* work_im;
+} FFTPlan;
+
+int fft_init(FFTPlan* plan, int real_size);
+void fft_free(FFTPlan* plan);
+void fft_complex(const FFTPlan* plan, float* re, float* im, int inverse);
+void fft_real_forward(const FFTPlan* plan, const float* input, float* re, float* im);
+void fft_real_inverse(const FFTPlan* plan, const float* re, const float* im, float* output);
+
+#endif
@@ -0,0 +1,343 @@
+#include "audio_graph.h"
+#include <stdio.h>
+#include <string.h>
+
+void audio_graph_init(AudioGraph* graph) {
+    memset(graph, 0, sizeof(*graph));
+}
+
+int audio_graph_add(AudioGraph* graph, AudioNodeKind kind, AudioNodeFunc process, void* state, int param) {
+    if (graph->node_count >= AUDIO_GRAPH_MAX_NODES) {
+        fprintf(stderr, "Audio graph is full (%d nodes)\n", AUDIO_GRAPH_MAX_NODES);
+        return -1;
+    }
+    if (!process && kind != AUDIO_NODE_BUS && kind != AUDIO_NODE_OUTPUT) {
+        fprintf(stderr, "Audio graph node of kind %d needs a process function\n", (int)kind);
+        return -1;
+    }
+    if (kind == AUDIO_NODE_OUTPUT && (param < 0 || param >= AUDIO_GRAPH_MAX_OUTPUTS)) {
+        fprintf(stderr, "Invalid audio graph output slot %d\n", param);
+        return -1;
+    }
+    
+    int index = (int)graph->node_count++;
+    AudioNode* node = &graph->nodes[index];
+    memset(node, 0, sizeof(*node));
+    node->kind = kind;
+    node->process = process;
+    node->state = state;
+    node->param = param;
+    node->gain = 1.0f;
+    node->rng = 0x2545f491u * (uint32_t)(index + 1);
+    return index;
+}
+
+int audio_graph_connect(AudioGraph* graph, int from, int to) {
+    if (from < 0 || to < 0 || from >= (int)graph->node_count || to >= (int)graph->node_count) {
+        return -1;
+    }
+    
+    AudioNode* node = &graph->nodes[to];
+    if (node->input_count >= AUDIO_GRAPH_MAX_INPUTS || graph->nodes[from].kind == AUDIO_NODE_OUTPUT) {
+        fprintf(stderr, "Cannot connect audio graph node %d to %d\n", from, to);
+        return -1;
+    }
+    node->inputs[node->input_count++] = from;
+    return 0;
+}
+
+int audio_graph_compile(const AudioGraph* graph, AudioGraphPlan* plan, const int* sinks, uint32_t sink_count, bool parallel) {
+    uint32_t n = graph->node_count;
+    bool reachable[AUDIO_GRAPH_MAX_NODES] = {false};
+    bool placed[AUDIO_GRAPH_MAX_NODES] = {false};
+    int level[AUDIO_GRAPH_MAX_NODES];
+    int last_use[AUDIO_GRAPH_MAX_NODES];
+    int stack[AUDIO_GRAPH_MAX_NODES];
+    int top = 0;
+    uint32_t wanted = 0;
+    
+    memset(plan, 0, sizeof(*plan));
+    
+    // Only nodes feeding the requested sinks get scheduled
+    for (uint32_t i = 0; i < sink_count; i++) {
+        if (sinks[i] >= 0 && sinks[i] < (int)n && !reachable[sinks[i]]) {
+            reachable[sinks[i]] = true;
+            stack[top++] = sinks[i];
+        }
+    }
+    while (top > 0) {
+        const AudioNode* node = &graph->nodes[stack[--top]];
+        wanted++;
+        for (int i = 0; i < node->input_count; i++) {
+            int input = node->inputs[i];
+            if (!reachable[input]) {
+                reachable[input] = true;
+                stack[top++] = input;
+            }
+        }
+    }
+    
+    if (parallel) {
+        // Kahn's algorithm one level at a time: a level is every node whose
+        // inputs were all placed in earlier levels
+        while (plan->node_count < wanted) {
+            uint32_t start = plan->node_count;
+            
+            for (uint32_t i = 0; i < n; i++) {
+                if (!reachable[i] || placed[i]) continue;
+                
+                const AudioNode* node = &graph->nodes[i];
+                bool ready = true;
+                for (int j = 0; j < node->input_count; j++) {
+                    int input = node->inputs[j];
+                    if (!placed[input] || level[input] == (int)plan->level_count) {
+                        ready = false;
+                        break;
+                    }
+                }
+                if (ready) {
+                    level[i] = (int)plan->level_count;
+                    plan->order[plan->node_count++] = (int)i;
+                    placed[i] = true;
+                }
+            }
+            
+            if (plan->node_count == start) {
+                fprintf(stderr, "Audio graph has a cycle\n");
+                return -1;
+            }
+            plan->level_start[plan->level_count++] = start;
+        }
+    } else {
+        // Depth-first post-order: each branch is finished and consumed
+        // before the next one starts, which keeps the fewest blocks live.
+        // Every node is its own level.
+        bool visiting[AUDIO_GRAPH_MAX_NODES] = {false};
+        int next_input[AUDIO_GRAPH_MAX_NODES];
+        
+        for (uint32_t i = 0; i < sink_count; i++) {
+            if (sinks[i] < 0 || sinks[i] >= (int)n || placed[sinks[i]]) continue;
+            
+            stack[top++] = sinks[i];
+            visiting[sinks[i]] = true;
+            next_input[sinks[i]] = 0;
+            while (top > 0) {
+                int index = stack[top - 1];
+                const AudioNode* node = &graph->nodes[index];
+                
+                if (next_input[index] < node->input_count) {
+                    int input = node->inputs[next_input[index]++];
+                    if (visiting[input]) {
+                        fprintf(stderr, "Audio graph has a cycle\n");
+                        return -1;
+                    }
+                    if (!placed[input]) {
+                        stack[top++] = input;
+                        visiting[input] = true;
+                        next_input[input] = 0;
+                    }
+                    continue;
+                }
+                
+                top--;
+                visiting[index] = false;
+                placed[index] = true;
+                level[index] = (int)plan->node_count;
+                plan->level_start[plan->level_count++] = plan->node_count;
+                plan->order[plan->node_count++] = index;
+            }
+        }
+    }
+    plan->level_start[plan->level_count] = plan->node_count;
+    
+    // Liveness: a block is free again once its last reader has run. With
+    // workers, readers in one level run concurrently, so lifetimes are
+    // rounded out to whole levels.
+    for (uint32_t i = 0; i < n; i++) {
+        last_use[i] = -1;
+        plan->buffer[i] = -1;
+    }
+    for (uint32_t p = 0; p < plan->node_count; p++) {
+        const AudioNode* node = &graph->nodes[plan->order[p]];
+        int when = parallel ? level[plan->order[p]] : (int)p;
+        for (int j = 0; j < node->input_count; j++) {
+            if (when > last_use[node->inputs[j]]) {
+                last_use[node->inputs[j]] = when;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < sink_count; i++) {
+        if (sinks[i] >= 0 && sinks[i] < (int)n && graph->nodes[sinks[i]].kind != AUDIO_NODE_OUTPUT) {
+            last_use[sinks[i]] = AUDIO_GRAPH_MAX_NODES;
+        }
+    }
+    
+    bool in_use[AUDIO_GRAPH_MAX_NODES] = {false};
+    bool released[AUDIO_GRAPH_MAX_NODES] = {false};
+    for (uint32_t p = 0; p < plan->node_count; p++) {
+        int index = plan->order[p];
+        int when = parallel ? level[index] : (int)p;
+        
+        // Release before allocating so a node can run in place over an
+        // input it is the last reader of
+        for (uint32_t q = 0; q < p; q++) {
+            int earlier = plan->order[q];
+            int buffer = plan->buffer[earlier];
+            bool expired = parallel ? last_use[earlier] < when : last_use[earlier] <= when;
+            if (buffer >= 0 && !released[earlier] && expired) {
+                in_use[buffer] = false;
+                released[earlier] = true;
+            }
+        }
+        
+        if (graph->nodes[index].kind == AUDIO_NODE_OUTPUT) {
+            continue;
+        }
+        
+        int buffer = 0;
+        while (in_use[buffer]) {
+            buffer++;
+        }
+        in_use[buffer] = true;
+        plan->buffer[index] = buffer;
+        if ((uint32_t)buffer + 1 > plan->buffer_count) {
+            plan->buffer_count = (uint32_t)buffer + 1;
+        }
+    }
+    
+    if (plan->buffer_count > 0) {
+        size_t bytes = (size_t)plan->buffer_count * AUDIO_GRAPH_BLOCK * sizeof(float);
+        plan->buffers = platform_aligned_alloc(bytes, 64);
+        if (!plan->buffers) {
+            fprintf(stderr, "Failed to allocate %u audio graph blocks\n", plan->buffer_count);
+            return -1;
+        }
+        memset(plan->buffers, 0, bytes);
+    }
+    plan->parallel = parallel;
+    return 0;
+}
+
+void audio_graph_plan_free(AudioGraphPlan* plan) {
+    platform_aligned_free(plan->buffers);
+    plan->buffers = NULL;
+    plan->buffer_count = 0;
+    plan->node_count = 0;
+}
+
+static void audio_graph_run_node(AudioGraph* graph, const AudioGraphPlan* plan, int index, uint32_t count) {
+    AudioNode* node = &graph->nodes[index];
+    const float* inputs[AUDIO_GRAPH_MAX_INPUTS];
+    float* output = NULL;
+    
+    for (int i = 0; i < node->input_count; i++) {
+        inputs[i] = plan->buffers + (size_t)plan->buffer[node->inputs[i]] * AUDIO_GRAPH_BLOCK;
+    }
+    if (plan->buffer[index] >= 0) {
+        output = plan->buffers + (size_t)plan->buffer[index] * AUDIO_GRAPH_BLOCK;
+    }
+    
+    if (node->process) {
+        node->process(node, inputs, output, count);
+    }
+    else if (node->kind == AUDIO_NODE_BUS) {
+        for (uint32_t s = 0; s < count; s++) {
+            float sum = 0.0f;
+            for (int i = 0; i < node->input_count; i++) {
+                sum += inputs[i][s];
+            }
+            output[s] = sum * node->gain;
+        }
+    }
+    else if (node->kind == AUDIO_NODE_OUTPUT) {
+        float* dst = graph->outputs[node->param];
+        if (dst && node->input_count > 0) {
+            memcpy(dst + graph->offset, inputs[0], count * sizeof(float));
+        }
+    }
+}
+
+static void audio_graph_drain(AudioGraph* graph) {
+    const AudioGraphPlan* plan = graph->job_plan;
+    uint32_t end = graph->job_end;
+    uint32_t p;
+    
+    while ((p = atomic_fetch_add_u32(&graph->job_next, 1)) < end) {
+        audio_graph_run_node(graph, plan, plan->order[p], graph->job_count);
+    }
+}
+
+static void audio_graph_worker(void* arg) {
+    AudioGraph* graph = (AudioGraph*)arg;
+    
+    for (;;) {
+        platform_semaphore_wait(&graph->wake);
+        if (atomic_load_u32(&graph->quit)) {
+            break;
+        }
+        audio_graph_drain(graph);
+        atomic_fetch_add_u32(&graph->job_pending, (uint32_t)-1);
+    }
+}
+
+int audio_graph_start_workers(AudioGraph* graph, uint32_t count) {
+    if (count > AUDIO_GRAPH_MAX_WORKERS) count = AUDIO_GRAPH_MAX_WORKERS;
+    if (count == 0) {
+        return 0;
+    }
+    if (platform_semaphore_init(&graph->wake) != 0) {
+        fprintf(stderr, "Failed to create audio graph semaphore\n");
+        return -1;
+    }
+    
+    graph->quit = 0;
+    graph->worker_count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (platform_thread_start(&graph->workers[i], audio_graph_worker, graph) != 0) {
+            fprintf(stderr, "Failed to start audio graph worker %u\n", i);
+            break;
+        }
+        graph->worker_count++;
+    }
+    return graph->worker_count > 0 ? 0 : -1;
+}
+
+void audio_graph_stop_workers(AudioGraph* graph) {
+    if (graph->worker_count == 0) {
+        return;
+    }
+    
+    atomic_store_u32(&graph->quit, 1);
+    platform_semaphore_post(&graph->wake, graph->worker_count);
+    for (uint32_t i = 0; i < graph->worker_count; i++) {
+        platform_thread_join(&graph->workers[i]);
+    }
+    platform_semaphore_destroy(&graph->wake);
+    graph->worker_count = 0;
+}
+
+void audio_graph_run(AudioGraph* graph, const AudioGraphPlan* plan, uint32_t offset, uint32_t count) {
+    graph->offset = offset;
+    
+    for (uint32_t l = 0; l < plan->level_count; l++) {
+        uint32_t start = plan->level_start[l];
+        uint32_t end = plan->level_start[l + 1];
+        
+        if (plan->parallel && graph->worker_count > 0 && end - start > 1) {
+            graph->job_plan = plan;
+            graph->job_count = count;
+            graph->job_end = end;
+            atomic_store_u32(&graph->job_next, start);
+            atomic_store_u32(&graph->job_pending, graph->worker_count);
+            platform_semaphore_post(&graph->wake, graph->worker_count);
+            
+            audio_graph_drain(graph);
+            while (atomic_load_u32(&graph->job_pending) != 0) {
+            }
+        } else {
+            for (uint32_t p = start; p < end; p++) {
+                audio_graph_run_node(graph, plan, plan->order[p], count);
+            }
+        }
+    }
+}
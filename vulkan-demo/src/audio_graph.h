@@ -0,0 +1,86 @@
+#ifndef AUDIO_GRAPH_H
+#define AUDIO_GRAPH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "platform.h"
+
+#define AUDIO_GRAPH_BLOCK 256
+#define AUDIO_GRAPH_MAX_NODES 32
+#define AUDIO_GRAPH_MAX_INPUTS 4
+#define AUDIO_GRAPH_MAX_OUTPUTS 8
+#define AUDIO_GRAPH_MAX_WORKERS 4
+
+typedef enum {
+    AUDIO_NODE_OSCILLATOR,
+    AUDIO_NODE_ENVELOPE,
+    AUDIO_NODE_FILTER,
+    AUDIO_NODE_BUS,
+    AUDIO_NODE_EFFECT,
+    AUDIO_NODE_OUTPUT
+} AudioNodeKind;
+
+typedef struct AudioNode AudioNode;
+
+// Processes count <= AUDIO_GRAPH_BLOCK samples. output may alias any of the
+// inputs, so kernels must read input[i] before writing output[i].
+typedef void (*AudioNodeFunc)(AudioNode* node, const float* const* inputs, float* output, uint32_t count);
+
+// Bus nodes without a process function sum their inputs and scale by gain.
+// Output nodes copy their single input to the graph output slot in param.
+struct AudioNode {
+    AudioNodeKind kind;
+    AudioNodeFunc process;
+    void* state;
+    int param;
+    float gain;
+    uint32_t rng;
+    int inputs[AUDIO_GRAPH_MAX_INPUTS];
+    int input_count;
+};
+
+// Execution order for one set of sinks. Nodes are grouped into levels whose
+// members only depend on earlier levels. Every node that produces samples
+// owns one scratch block for its lifetime; blocks are recycled once their
+// last reader has run, per node or per level when compiled for workers.
+typedef struct {
+    int order[AUDIO_GRAPH_MAX_NODES];
+    int buffer[AUDIO_GRAPH_MAX_NODES];
+    uint32_t level_start[AUDIO_GRAPH_MAX_NODES + 1];
+    uint32_t node_count;
+    uint32_t level_count;
+    uint32_t buffer_count;
+    bool parallel;
+    float* buffers;
+} AudioGraphPlan;
+
+typedef struct {
+    AudioNode nodes[AUDIO_GRAPH_MAX_NODES];
+    uint32_t node_count;
+    float* outputs[AUDIO_GRAPH_MAX_OUTPUTS];
+    uint32_t offset;
+
+    // Worker pool. The thread calling audio_graph_run() takes part in every
+    // level and waits for the rest before moving on.
+    PlatformThread workers[AUDIO_GRAPH_MAX_WORKERS];
+    uint32_t worker_count;
+    PlatformSemaphore wake;
+    const AudioGraphPlan* job_plan;
+    uint32_t job_count;
+    volatile uint32_t job_next;
+    volatile uint32_t job_end;
+    volatile uint32_t job_pending;
+    volatile uint32_t quit;
+} AudioGraph;
+
+void audio_graph_init(AudioGraph* graph);
+int audio_graph_add(AudioGraph* graph, AudioNodeKind kind, AudioNodeFunc process, void* state, int param);
+int audio_graph_connect(AudioGraph* graph, int from, int to);
+int audio_graph_compile(const AudioGraph* graph, AudioGraphPlan* plan, const int* sinks, uint32_t sink_count, bool parallel);
+void audio_graph_plan_free(AudioGraphPlan* plan);
+int audio_graph_start_workers(AudioGraph* graph, uint32_t count);
+void audio_graph_stop_workers(AudioGraph* graph);
+void audio_graph_run(AudioGraph* graph, const AudioGraphPlan* plan, uint32_t offset, uint32_t count);
+
+#endif
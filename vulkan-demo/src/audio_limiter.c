@@ -0,0 +1,79 @@
+#include "audio_limiter.h"
+#include <math.h>
+
+void audio_limiter_init(AudioLimiter* limiter, float sample_rate, float lookahead_ms, float release_ms, float ceiling) {
+    uint32_t lookahead = (uint32_t)(lookahead_ms * 0.001f * sample_rate);
+    if (lookahead < 1) lookahead = 1;
+    if (lookahead > LIMITER_BUFFER - 2) lookahead = LIMITER_BUFFER - 2;
+    
+    for (uint32_t i = 0; i < LIMITER_BUFFER; i++) {
+        limiter->delay[i] = 0.0f;
+        limiter->gain_history[i] = 1.0f;
+    }
+    limiter->deque_head = 0;
+    limiter->deque_tail = 0;
+    limiter->pos = 0;
+    limiter->lookahead = lookahead;
+    limiter->ceiling = ceiling;
+    limiter->release_coef = 1.0f - expf(-1.0f / (release_ms * 0.001f * sample_rate));
+    limiter->envelope = 1.0f;
+    limiter->inv_lookahead = 1.0f / (float)lookahead;
+    limiter->gain_sum = (double)lookahead;
+}
+
+uint32_t audio_limiter_latency(const AudioLimiter* limiter) {
+    return limiter->lookahead;
+}
+
+void audio_limiter_process(AudioLimiter* limiter, const float* input, float* output, uint32_t count) {
+    const uint32_t mask = LIMITER_BUFFER - 1;
+    uint32_t lookahead = limiter->lookahead;
+    uint32_t head = limiter->deque_head;
+    uint32_t tail = limiter->deque_tail;
+    uint32_t pos = limiter->pos;
+    float envelope = limiter->envelope;
+    double gain_sum = limiter->gain_sum;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        float x = input[i];
+        float a = fabsf(x);
+        
+        // Monotonic deque of (index, |x|): values decrease from head to
+        // tail, so the head is the maximum of the last lookahead + 1 inputs.
+        // Every index is pushed and popped at most once.
+        while (tail != head && limiter->deque_value[(tail - 1) & mask] <= a) {
+            tail--;
+        }
+        limiter->deque_index[tail & mask] = pos;
+        limiter->deque_value[tail & mask] = a;
+        tail++;
+        while (pos - limiter->deque_index[head & mask] > lookahead) {
+            head++;
+        }
+        
+        float peak = limiter->deque_value[head & mask];
+        float target = (peak > limiter->ceiling) ? limiter->ceiling / peak : 1.0f;
+        
+        // Gain drops instantly and recovers with the release time; the
+        // lookahead-long moving average then turns the drops into ramps
+        // that still reach the target before the peak leaves the delay
+        if (target < envelope) {
+            envelope = target;
+        } else {
+            envelope += limiter->release_coef * (target - envelope);
+        }
+        gain_sum += (double)envelope - (double)limiter->gain_history[(pos - lookahead) & mask];
+        limiter->gain_history[pos & mask] = envelope;
+        
+        float delayed = limiter->delay[(pos - lookahead) & mask];
+        limiter->delay[pos & mask] = x;
+        output[i] = delayed * (float)gain_sum * limiter->inv_lookahead;
+        pos++;
+    }
+    
+    limiter->deque_head = head;
+    limiter->deque_tail = tail;
+    limiter->pos = pos;
+    limiter->envelope = envelope;
+    limiter->gain_sum = gain_sum;
+}
@@ -0,0 +1,31 @@
+#ifndef AUDIO_LIMITER_H
+#define AUDIO_LIMITER_H
+
+#include <stdint.h>
+
+// Power of two; bounds the lookahead and sizes every ring below
+#define LIMITER_BUFFER 512
+
+// Lookahead brickwall limiter. Output is delayed by lookahead samples and
+// never exceeds the ceiling.
+typedef struct {
+    float delay[LIMITER_BUFFER];
+    float gain_history[LIMITER_BUFFER];
+    uint32_t deque_index[LIMITER_BUFFER];
+    float deque_value[LIMITER_BUFFER];
+    uint32_t deque_head;
+    uint32_t deque_tail;
+    uint32_t pos;
+    uint32_t lookahead;
+    float ceiling;
+    float release_coef;
+    float envelope;
+    float inv_lookahead;
+    double gain_sum;
+} AudioLimiter;
+
+void audio_limiter_init(AudioLimiter* limiter, float sample_rate, float lookahead_ms, float release_ms, float ceiling);
+void audio_limiter_process(AudioLimiter* limiter, const float* input, float* output, uint32_t count);
+uint32_t audio_limiter_latency(const AudioLimiter* limiter);
+
+#endif
@@ -0,0 +1,320 @@
+#include "audio_onset.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI 3.14159265359f
+
+// Log compression applied to magnitudes before differencing, so quiet and
+// loud passages produce comparable flux
+#define ONSET_COMPRESSION 100.0f
+#define ONSET_THRESHOLD_DEV 2.0f
+#define ONSET_THRESHOLD_FLOOR 0.5f
+#define ONSET_THRESHOLD_ALPHA 0.02f
+#define ONSET_MIN_GAP_SECONDS 0.08f
+
+#define BEAT_MIN_BPM 60.0f
+#define BEAT_MAX_BPM 200.0f
+#define BEAT_PRIOR_BPM 120.0f
+#define BEAT_ESTIMATE_EVERY 43
+#define BEAT_WARMUP_HOPS 512
+#define BEAT_SWITCH_VOTES 8
+
+static const int band_bins[ONSET_BAND_COUNT][2] = {
+    {2, 7},     // ~43-150 Hz: kick body
+    {9, 232},   // ~200 Hz-5 kHz: snare crack and noise
+};
+
+bool onset_queue_push(OnsetQueue* queue, const OnsetEvent* event) {
+    uint32_t tail = queue->tail;
+    if (tail - atomic_load_u32(&queue->head) >= ONSET_QUEUE_SIZE) {
+        return false;
+    }
+    queue->events[tail & (ONSET_QUEUE_SIZE - 1)] = *event;
+    atomic_store_u32(&queue->tail, tail + 1);
+    return true;
+}
+
+bool onset_queue_pop(OnsetQueue* queue, OnsetEvent* event) {
+    uint32_t head = queue->head;
+    if (head == atomic_load_u32(&queue->tail)) {
+        return false;
+    }
+    *event = queue->events[head & (ONSET_QUEUE_SIZE - 1)];
+    atomic_store_u32(&queue->head, head + 1);
+    return true;
+}
+
+static uint32_t hop_sample_pos(const OnsetDetector* detector, double hop) {
+    // The newest hop analysed the frame ending at read_pos. Stamps use the
+    // frame centre, and predicted beats may be ahead of read_pos.
+    double newest = (double)(detector->hop_count - 1);
+    int32_t offset = (int32_t)floor((hop - newest) * ONSET_HOP + 0.5);
+    return detector->read_pos + (uint32_t)offset - ONSET_FFT_SIZE / 2;
+}
+
+static void publish(OnsetDetector* detector, OnsetEventType type, uint32_t sample_pos, float strength) {
+    OnsetEvent event;
+    event.sample_pos = sample_pos;
+    event.time = (float)sample_pos / detector->sample_rate;
+    event.strength = strength;
+    event.tempo = detector->beat_locked ? 60.0f * detector->sample_rate / (detector->period * ONSET_HOP) : 0.0f;
+    event.type = type;
+    onset_queue_push(&detector->queue, &event);
+}
+
+static void anchor_beat(OnsetDetector* detector, float period) {
+    // Place the phase on the strongest onset within the last period
+    uint32_t h = detector->hop_count;
+    uint32_t peak = h - 1;
+    for (uint32_t i = 1; i <= (uint32_t)period; i++) {
+        if (detector->odf[(h - i) & (ONSET_HISTORY - 1)] > detector->odf[peak & (ONSET_HISTORY - 1)]) {
+            peak = h - i;
+        }
+    }
+    detector->period = period;
+    detector->next_beat = (double)peak + period;
+}
+
+static void estimate_tempo(OnsetDetector* detector) {
+    uint32_t h = detector->hop_count;
+    int count = h < ONSET_HISTORY ? (int)h : ONSET_HISTORY;
+    float hops_per_second = detector->sample_rate / ONSET_HOP;
+    int min_lag = (int)(hops_per_second * 60.0f / BEAT_MAX_BPM);
+    int max_lag = (int)(hops_per_second * 60.0f / BEAT_MIN_BPM) + 1;
+    float prior_lag = hops_per_second * 60.0f / BEAT_PRIOR_BPM;
+    
+    float mean = 0.0f;
+    for (int i = 0; i < count; i++) {
+        mean += detector->odf[(h - 1 - i) & (ONSET_HISTORY - 1)];
+    }
+    mean /= (float)count;
+    
+    // Autocorrelation of the onset strength. Each candidate period also
+    // collects half the correlation at twice its lag, and the sum is weighted
+    // by a log-Gaussian around the prior tempo to steer away from octave
+    // and triplet errors.
+    float acf[ONSET_HISTORY / 2];
+    float scores[ONSET_HISTORY / 4];
+    for (int lag = min_lag - 1; lag <= 2 * (max_lag + 1); lag++) {
+        float sum = 0.0f;
+        for (int i = 0; i + lag < count; i++) {
+            float a = detector->odf[(h - 1 - i) & (ONSET_HISTORY - 1)] - mean;
+            float b = detector->odf[(h - 1 - i - lag) & (ONSET_HISTORY - 1)] - mean;
+            sum += a * b;
+        }
+        acf[lag] = sum / (float)(count - lag);
+    }
+    
+    int best_lag = 0;
+    for (int lag = min_lag - 1; lag <= max_lag + 1; lag++) {
+        float octave = log2f((float)lag / prior_lag);
+        scores[lag] = (acf[lag] + 0.5f * acf[2 * lag]) * expf(-0.5f * octave * octave);
+        
+        if (lag >= min_lag && lag <= max_lag && (best_lag == 0 || scores[lag] > scores[best_lag])) {
+            best_lag = lag;
+        }
+    }
+    
+    if (scores[best_lag] <= 0.0f) {
+        return;
+    }
+    
+    // Parabolic interpolation for a sub-hop period
+    float period = (float)best_lag;
+    float left = scores[best_lag - 1];
+    float right = scores[best_lag + 1];
+    float denom = left - 2.0f * scores[best_lag] + right;
+    if (denom < 0.0f) {
+        period += 0.5f * (left - right) / denom;
+    }
+    
+    if (!detector->beat_locked) {
+        anchor_beat(detector, period);
+        detector->beat_locked = true;
+        publish(detector, ONSET_EVENT_BEAT, hop_sample_pos(detector, detector->next_beat), 1.0f);
+    } else if (fabsf(period - detector->period) < 0.08f * detector->period) {
+        detector->period += 0.25f * (period - detector->period);
+        detector->tempo_votes = 0;
+    } else if (++detector->tempo_votes >= BEAT_SWITCH_VOTES) {
+        // A different tempo has to win several estimates in a row before
+        // it replaces the tracked one
+        anchor_beat(detector, period);
+        detector->tempo_votes = 0;
+    }
+}
+
+static void track_beat(OnsetDetector* detector) {
+    double tolerance = 0.15 * detector->period;
+    double newest = (double)(detector->hop_count - 1);
+    
+    if (newest < detector->next_beat + tolerance) {
+        return;
+    }
+    
+    // The predicted beat is now fully in the past; pull its phase towards
+    // the strongest onset nearby and predict the one after it
+    int first = (int)ceil(detector->next_beat - tolerance);
+    int last = (int)floor(detector->next_beat + tolerance);
+    int peak = -1;
+    float peak_value = 0.0f;
+    float mean = 0.0f;
+    for (int i = first; i <= last; i++) {
+        float v = detector->odf[(uint32_t)i & (ONSET_HISTORY - 1)];
+        mean += v;
+        if (v > peak_value) {
+            peak_value = v;
+            peak = i;
+        }
+    }
+    mean /= (float)(last - first + 1);
+    
+    if (peak >= 0 && peak_value > 2.0f * mean) {
+        detector->next_beat += 0.5 * ((double)peak - detector->next_beat);
+    }
+    detector->next_beat += detector->period;
+    
+    publish(detector, ONSET_EVENT_BEAT, hop_sample_pos(detector, detector->next_beat), peak_value);
+}
+
+void onset_detector_process(OnsetDetector* detector, const float* ring, uint32_t end_pos) {
+    uint32_t start = end_pos - ONSET_FFT_SIZE;
+    for (int i = 0; i < ONSET_FFT_SIZE; i++) {
+        detector->frame[i] = ring[(start + (uint32_t)i) & (AUDIO_RING_SIZE - 1)] * detector->window[i];
+    }
+    fft_real_forward(&detector->plan, detector->frame, detector->re, detector->im);
+    
+    // Half-wave rectified spectral flux on log-compressed magnitudes
+    float band_flux[ONSET_BAND_COUNT] = {0.0f, 0.0f};
+    float total_flux = 0.0f;
+    for (int k = 1; k < ONSET_BINS; k++) {
+        float re = detector->re[k];
+        float im = detector->im[k];
+        float mag = logf(1.0f + ONSET_COMPRESSION * sqrtf(re * re + im * im));
+        float rise = mag - detector->prev_mag[k];
+        detector->prev_mag[k] = mag;
+        
+        if (rise <= 0.0f) {
+            continue;
+        }
+        total_flux += rise;
+        for (int b = 0; b < ONSET_BAND_COUNT; b++) {
+            if (k >= band_bins[b][0] && k <= band_bins[b][1]) {
+                band_flux[b] += rise;
+            }
+        }
+    }
+    
+    detector->read_pos = end_pos;
+    uint32_t h = detector->hop_count++;
+    detector->odf[h & (ONSET_HISTORY - 1)] = total_flux + 4.0f * band_flux[ONSET_BAND_LOW];
+    
+    // Peak-pick per band: the previous hop is an onset if it is a local
+    // maximum above mean + k * deviation of the recent flux
+    uint32_t min_gap = (uint32_t)(ONSET_MIN_GAP_SECONDS * detector->sample_rate / ONSET_HOP);
+    for (int b = 0; b < ONSET_BAND_COUNT; b++) {
+        float* f = detector->flux[b];
+        f[2] = f[1];
+        f[1] = f[0];
+        f[0] = band_flux[b];
+        
+        float threshold = detector->flux_mean[b] + ONSET_THRESHOLD_DEV * detector->flux_dev[b] + ONSET_THRESHOLD_FLOOR;
+        if (h >= 2 && f[1] > threshold && f[1] > f[2] && f[1] >= f[0] &&
+            h - 1 - detector->last_onset[b] >= min_gap) {
+            detector->last_onset[b] = h - 1;
+            publish(detector, b == ONSET_BAND_LOW ? ONSET_EVENT_KICK : ONSET_EVENT_SNARE,
+                    hop_sample_pos(detector, (double)(h - 1)), f[1] / threshold);
+        }
+        
+        detector->flux_dev[b] += ONSET_THRESHOLD_ALPHA * (fabsf(f[0] - detector->flux_mean[b]) - detector->flux_dev[b]);
+        detector->flux_mean[b] += ONSET_THRESHOLD_ALPHA * (f[0] - detector->flux_mean[b]);
+    }
+    
+    if (detector->hop_count >= BEAT_WARMUP_HOPS && detector->hop_count % BEAT_ESTIMATE_EVERY == 0) {
+        estimate_tempo(detector);
+    }
+    if (detector->beat_locked) {
+        track_beat(detector);
+    }
+}
+
+static void onset_thread(void* arg) {
+    OnsetDetector* detector = (OnsetDetector*)arg;
+    AudioEngine* audio = detector->audio;
+    
+    while (atomic_load_u32(&detector->running)) {
+        uint32_t write_pos = atomic_load_u32(&audio->ring_write);
+        uint32_t pending = write_pos - detector->read_pos;
+        
+        if (pending > AUDIO_RING_SIZE - ONSET_FFT_SIZE) {
+            // Fell too far behind; the oldest samples are already gone
+            detector->read_pos = write_pos - (write_pos % ONSET_HOP);
+            continue;
+        }
+        if (pending < ONSET_HOP) {
+            platform_sleep_ms(2);
+            continue;
+        }
+        onset_detector_process(detector, audio->analysis_ring, detector->read_pos + ONSET_HOP);
+    }
+}
+
+static void onset_detector_free(OnsetDetector* detector) {
+    fft_free(&detector->plan);
+    free(detector->window);
+    free(detector->frame);
+    free(detector->re);
+    free(detector->im);
+    free(detector->prev_mag);
+    detector->window = NULL;
+    detector->frame = NULL;
+    detector->re = NULL;
+    detector->im = NULL;
+    detector->prev_mag = NULL;
+}
+
+int onset_detector_start(OnsetDetector* detector, AudioEngine* audio) {
+    memset(detector, 0, sizeof(*detector));
+    detector->audio = audio;
+    detector->sample_rate = audio->sequencer.sample_rate;
+    
+    if (fft_init(&detector->plan, ONSET_FFT_SIZE) != 0) {
+        return -1;
+    }
+    
+    detector->window = malloc(ONSET_FFT_SIZE * sizeof(float));
+    detector->frame = malloc(ONSET_FFT_SIZE * sizeof(float));
+    detector->re = malloc((ONSET_FFT_SIZE / 2 + 1) * sizeof(float));
+    detector->im = malloc((ONSET_FFT_SIZE / 2 + 1) * sizeof(float));
+    detector->prev_mag = calloc(ONSET_BINS, sizeof(float));
+    
+    if (!detector->window || !detector->frame || !detector->re || !detector->im || !detector->prev_mag) {
+        onset_detector_free(detector);
+        return -1;
+    }
+    
+    // Hann window, scaled so a full-scale sine peaks at magnitude 1
+    for (int i = 0; i < ONSET_FFT_SIZE; i++) {
+        detector->window[i] = (0.5f - 0.5f * cosf(2.0f * PI * (float)i / (float)ONSET_FFT_SIZE)) * (4.0f / ONSET_FFT_SIZE);
+    }
+    
+    uint32_t write_pos = atomic_load_u32(&audio->ring_write);
+    detector->read_pos = write_pos - (write_pos % ONSET_HOP);
+    detector->running = 1;
+    
+    if (platform_thread_start(&detector->thread, onset_thread, detector) != 0) {
+        detector->running = 0;
+        onset_detector_free(detector);
+        return -1;
+    }
+    return 0;
+}
+
+void onset_detector_stop(OnsetDetector* detector) {
+    if (!atomic_load_u32(&detector->running)) {
+        return;
+    }
+    atomic_store_u32(&detector->running, 0);
+    platform_thread_join(&detector->thread);
+    onset_detector_free(detector);
+}
@@ -0,0 +1,85 @@
+#ifndef AUDIO_ONSET_H
+#define AUDIO_ONSET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "audio_synthesis.h"
+#include "platform.h"
+
+#define ONSET_FFT_SIZE 2048
+#define ONSET_HOP 256
+#define ONSET_BINS 512
+#define ONSET_HISTORY 1024
+#define ONSET_QUEUE_SIZE 256
+
+typedef enum {
+    ONSET_BAND_LOW,
+    ONSET_BAND_MID,
+    ONSET_BAND_COUNT
+} OnsetBand;
+
+typedef enum {
+    ONSET_EVENT_KICK,
+    ONSET_EVENT_SNARE,
+    ONSET_EVENT_BEAT
+} OnsetEventType;
+
+// sample_pos is in the engine's ring_write timeline. Onsets are stamped at
+// the centre of the analysis frame that detected them; beats are stamped at
+// the predicted time of the next beat and may lie in the future.
+typedef struct {
+    uint32_t sample_pos;
+    float time;
+    float strength;
+    float tempo;
+    OnsetEventType type;
+} OnsetEvent;
+
+// Single-producer single-consumer queue: the detector thread pushes, the
+// main thread pops. Events are dropped when the consumer falls behind.
+typedef struct {
+    OnsetEvent events[ONSET_QUEUE_SIZE];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+} OnsetQueue;
+
+typedef struct {
+    AudioEngine* audio;
+    float sample_rate;
+    FFTPlan plan;
+    float* window;
+    float* frame;
+    float* re;
+    float* im;
+    float* prev_mag;
+    uint32_t read_pos;
+    uint32_t hop_count;
+
+    // Adaptive threshold state per band, plus the last two flux values
+    // so a peak can be confirmed one hop later
+    float flux[ONSET_BAND_COUNT][3];
+    float flux_mean[ONSET_BAND_COUNT];
+    float flux_dev[ONSET_BAND_COUNT];
+    uint32_t last_onset[ONSET_BAND_COUNT];
+
+    // Beat tracker: full-band onset strength history, tempo as a period
+    // in hops and the predicted next beat on the hop timeline
+    float odf[ONSET_HISTORY];
+    float period;
+    double next_beat;
+    int tempo_votes;
+    bool beat_locked;
+
+    OnsetQueue queue;
+    PlatformThread thread;
+    volatile uint32_t running;
+} OnsetDetector;
+
+int onset_detector_start(OnsetDetector* detector, AudioEngine* audio);
+void onset_detector_stop(OnsetDetector* detector);
+void onset_detector_process(OnsetDetector* detector, const float* ring, uint32_t end_pos);
+bool onset_queue_push(OnsetQueue* queue, const OnsetEvent* event);
+bool onset_queue_pop(OnsetQueue* queue, OnsetEvent* event);
+
+#endif
@@ -0,0 +1,143 @@
+#include "audio_oversampler.h"
+#include <string.h>
+#include <math.h>
+
+#define HALFBAND_PI 3.14159265358979
+
+static double halfband_bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Kaiser-windowed sinc at half the rate, with the odd taps rescaled so the
+// filter passes DC at exactly unity
+static void halfband_design(AudioHalfband* hb, uint32_t coef_count, double beta) {
+    double half = 2.0 * coef_count;
+    double sum = 0.0;
+    
+    for (uint32_t i = 0; i < coef_count; i++) {
+        double n = 2.0 * i + 1.0;
+        double r = n / half;
+        double window = halfband_bessel_i0(beta * sqrt(1.0 - r * r)) / halfband_bessel_i0(beta);
+        double sinc = sin(HALFBAND_PI * n / 2.0) / (HALFBAND_PI * n / 2.0);
+        hb->coefs[i] = (float)(0.5 * sinc * window);
+        sum += 2.0 * hb->coefs[i];
+    }
+    for (uint32_t i = 0; i < coef_count; i++) {
+        hb->coefs[i] = (float)(hb->coefs[i] * 0.5 / sum);
+    }
+    hb->coef_count = coef_count;
+}
+
+static void halfband_reset(AudioHalfband* hb) {
+    memset(hb->up_history, 0, sizeof(hb->up_history));
+    memset(hb->down_history, 0, sizeof(hb->down_history));
+}
+
+// count <= HALFBAND_CHUNK inputs become 2 * count outputs. The even outputs
+// land on the centre tap and are plain delayed inputs; only the odd ones
+// need the filter.
+static void halfband_up(AudioHalfband* hb, const float* input, float* output, uint32_t count) {
+    uint32_t k = hb->coef_count;
+    uint32_t history = 2 * k - 1;
+    float work[2 * HALFBAND_MAX_COEFS + HALFBAND_CHUNK];
+    
+    memcpy(work, hb->up_history, history * sizeof(float));
+    memcpy(work + history, input, count * sizeof(float));
+    
+    for (uint32_t p = 0; p < count; p++) {
+        const float* x = work + p + k - 1;
+        float odd = 0.0f;
+        for (uint32_t i = 0; i < k; i++) {
+            odd += hb->coefs[i] * (x[-(int32_t)i] + x[i + 1]);
+        }
+        output[2 * p + 0] = x[0];
+        output[2 * p + 1] = 2.0f * odd;
+    }
+    
+    memcpy(hb->up_history, work + count, history * sizeof(float));
+}
+
+// 2 * count inputs become count <= HALFBAND_CHUNK outputs; only the samples
+// that are kept get filtered
+static void halfband_down(AudioHalfband* hb, const float* input, float* output, uint32_t count) {
+    uint32_t k = hb->coef_count;
+    uint32_t history = 4 * k - 2;
+    float work[4 * HALFBAND_MAX_COEFS + 2 * HALFBAND_CHUNK];
+    
+    memcpy(work, hb->down_history, history * sizeof(float));
+    memcpy(work + history, input, 2 * count * sizeof(float));
+    
+    for (uint32_t r = 0; r < count; r++) {
+        const float* x = work + 2 * k + 2 * r;
+        float sum = 0.5f * x[0];
+        for (uint32_t i = 0; i < k; i++) {
+            sum += hb->coefs[i] * (x[-(int32_t)(2 * i + 1)] + x[2 * i + 1]);
+        }
+        output[r] = sum;
+    }
+    
+    memcpy(hb->down_history, work + 2 * count, history * sizeof(float));
+}
+
+void audio_oversampler_init(AudioOversampler* os, uint32_t factor) {
+    // 31 taps keep the base band flat to about 0.35 fs and everything
+    // above 0.68 fs 80 dB down; the 4x stage has a far wider transition
+    // band and gets by on 11
+    halfband_design(&os->stages[0], 8, 7.0);
+    halfband_design(&os->stages[1], 3, 5.0);
+    os->factor = (factor >= 4) ? 4 : (factor >= 2) ? 2 : 1;
+    audio_oversampler_reset(os);
+}
+
+void audio_oversampler_reset(AudioOversampler* os) {
+    halfband_reset(&os->stages[0]);
+    halfband_reset(&os->stages[1]);
+}
+
+// output holds count * factor samples
+void audio_oversampler_upsample(AudioOversampler* os, const float* input, float* output, uint32_t count) {
+    float twice[2 * HALFBAND_CHUNK];
+    uint32_t chunk = HALFBAND_CHUNK / 2;
+    
+    if (os->factor == 1) {
+        memmove(output, input, count * sizeof(float));
+        return;
+    }
+    
+    for (uint32_t start = 0; start < count; start += chunk) {
+        uint32_t n = (count - start < chunk) ? count - start : chunk;
+        if (os->factor == 2) {
+            halfband_up(&os->stages[0], input + start, output + start * 2, n);
+        } else {
+            halfband_up(&os->stages[0], input + start, twice, n);
+            halfband_up(&os->stages[1], twice, output + start * 4, n * 2);
+        }
+    }
+}
+
+// input holds count * factor samples
+void audio_oversampler_downsample(AudioOversampler* os, const float* input, float* output, uint32_t count) {
+    float twice[2 * HALFBAND_CHUNK];
+    uint32_t chunk = HALFBAND_CHUNK / 2;
+    
+    if (os->factor == 1) {
+        memmove(output, input, count * sizeof(float));
+        return;
+    }
+    
+    for (uint32_t start = 0; start < count; start += chunk) {
+        uint32_t n = (count - start < chunk) ? count - start : chunk;
+        if (os->factor == 2) {
+            halfband_down(&os->stages[0], input + start * 2, output + start, n);
+        } else {
+            halfband_down(&os->stages[1], input + start * 4, twice, n * 2);
+            halfband_down(&os->stages[0], twice, output + start, n);
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef AUDIO_OVERSAMPLER_H
+#define AUDIO_OVERSAMPLER_H
+
+#include <stdint.h>
+
+#define OVERSAMPLE_MAX_FACTOR 4
+#define HALFBAND_MAX_COEFS 8
+#define HALFBAND_CHUNK 128
+
+// Linear-phase halfband FIR. Every even tap but the centre is zero, so only
+// the odd taps are stored, folded by symmetry: coefs[i] multiplies the pair
+// of samples 2i + 1 either side of the centre.
+typedef struct {
+    float coefs[HALFBAND_MAX_COEFS];
+    uint32_t coef_count;
+    float up_history[2 * HALFBAND_MAX_COEFS];
+    float down_history[4 * HALFBAND_MAX_COEFS];
+} AudioHalfband;
+
+// 2x or 4x oversampling as a cascade of halfband stages. The first stage
+// sits next to the base rate and needs the steep transition band; the
+// second only has to reject images above the 2x band and is much shorter.
+typedef struct {
+    AudioHalfband stages[2];
+    uint32_t factor;
+} AudioOversampler;
+
+void audio_oversampler_init(AudioOversampler* os, uint32_t factor);
+void audio_oversampler_reset(AudioOversampler* os);
+void audio_oversampler_upsample(AudioOversampler* os, const float* input, float* output, uint32_t count);
+void audio_oversampler_downsample(AudioOversampler* os, const float* input, float* output, uint32_t count);
+
+#endif
@@ -0,0 +1,161 @@
+#include "audio_resampler.h"
+#include "audio_simd.h"
+#include "platform.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define RESAMPLER_PI 3.14159265358979
+
+static const struct {
+    uint32_t taps;
+    float bandwidth;
+    float beta;
+} resample_presets[] = {
+    {16, 0.80f, 5.0f},
+    {32, 0.90f, 7.0f},
+    {64, 0.95f, 9.0f}
+};
+
+static uint32_t resampler_gcd(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth-order modified Bessel function, for the Kaiser window
+static double resampler_bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+int audio_resampler_init(AudioResampler* resampler, uint32_t in_rate, uint32_t out_rate, AudioResampleQuality quality) {
+    uint32_t divisor = resampler_gcd(in_rate, out_rate);
+    uint32_t phases = out_rate / divisor;
+    uint32_t step = in_rate / divisor;
+    uint32_t taps = resample_presets[quality].taps;
+    
+    memset(resampler, 0, sizeof(*resampler));
+    if (phases > RESAMPLER_MAX_PHASES) {
+        fprintf(stderr, "Cannot resample %u Hz to %u Hz: %u phases needed\n", in_rate, out_rate, phases);
+        return -1;
+    }
+    
+    resampler->kernels = platform_aligned_alloc((size_t)phases * taps * sizeof(float), 16);
+    if (!resampler->kernels) {
+        fprintf(stderr, "Failed to allocate resampler kernels\n");
+        return -1;
+    }
+    
+    // Cut off below the lower of the two Nyquist frequencies
+    double cutoff = resample_presets[quality].bandwidth * (phases < step ? (double)phases / step : 1.0);
+    double beta = resample_presets[quality].beta;
+    double half = taps / 2.0;
+    double window_norm = 1.0 / resampler_bessel_i0(beta);
+    
+    for (uint32_t p = 0; p < phases; p++) {
+        float* kernel = resampler->kernels + (size_t)p * taps;
+        double sum = 0.0;
+        
+        for (uint32_t j = 0; j < taps; j++) {
+            // Distance in input samples from tap j to the output position
+            double d = (double)j - half + 1.0 - (double)p / phases;
+            double x = RESAMPLER_PI * cutoff * d;
+            double sinc = (fabs(x) < 1e-9) ? 1.0 : sin(x) / x;
+            double r = d / half;
+            double window = (fabs(r) < 1.0) ? resampler_bessel_i0(beta * sqrt(1.0 - r * r)) * window_norm : 0.0;
+            kernel[j] = (float)(cutoff * sinc * window);
+            sum += kernel[j];
+        }
+        
+        // Unity gain at DC for every phase
+        for (uint32_t j = 0; j < taps; j++) {
+            kernel[j] = (float)(kernel[j] / sum);
+        }
+    }
+    
+    resampler->taps = taps;
+    resampler->phases = phases;
+    resampler->step = step;
+    resampler->phase = 0;
+    resampler->offset = -(int32_t)(taps / 2);
+    return 0;
+}
+
+void audio_resampler_free(AudioResampler* resampler) {
+    platform_aligned_free(resampler->kernels);
+    resampler->kernels = NULL;
+}
+
+uint32_t audio_resampler_latency(const AudioResampler* resampler) {
+    return resampler->taps / 2;
+}
+
+// Input samples that must be supplied to produce out_count more outputs
+uint32_t audio_resampler_input_needed(const AudioResampler* resampler, uint32_t out_count) {
+    if (out_count == 0) {
+        return 0;
+    }
+    
+    int64_t last = resampler->offset + (int64_t)(resampler->phase + (uint64_t)(out_count - 1) * resampler->step) / resampler->phases;
+    int64_t needed = last + resampler->taps / 2 + 1;
+    return needed > 0 ? (uint32_t)needed : 0;
+}
+
+static float resampler_dot(const float* x, const float* kernel, uint32_t taps) {
+#ifdef AUDIO_SIMD_SSE
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (uint32_t j = 0; j < taps; j += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + j), _mm_load_ps(kernel + j)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + j + 4), _mm_load_ps(kernel + j + 4)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(acc0);
+#else
+    float sum = 0.0f;
+    for (uint32_t j = 0; j < taps; j++) {
+        sum += x[j] * kernel[j];
+    }
+    return sum;
+#endif
+}
+
+// in_count must be audio_resampler_input_needed(out_count) and at most
+// RESAMPLER_MAX_INPUT
+void audio_resampler_process(AudioResampler* resampler, const float* input, uint32_t in_count, float* output, uint32_t out_count) {
+    uint32_t taps = resampler->taps;
+    uint32_t phases = resampler->phases;
+    uint32_t step = resampler->step;
+    uint32_t phase = resampler->phase;
+    int32_t offset = resampler->offset;
+    float* work = resampler->work;
+    
+    // The last taps inputs followed by the new block, so every kernel
+    // window is contiguous
+    memcpy(work, resampler->history, taps * sizeof(float));
+    memcpy(work + taps, input, in_count * sizeof(float));
+    
+    for (uint32_t i = 0; i < out_count; i++) {
+        const float* x = work + (offset + (int32_t)(taps / 2) + 1);
+        output[i] = resampler_dot(x, resampler->kernels + (size_t)phase * taps, taps);
+        
+        phase += step;
+        offset += (int32_t)(phase / phases);
+        phase %= phases;
+    }
+    
+    memcpy(resampler->history, work + in_count, taps * sizeof(float));
+    resampler->phase = phase;
+    resampler->offset = offset - (int32_t)in_count;
+}
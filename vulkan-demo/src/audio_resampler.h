@@ -0,0 +1,37 @@
+#ifndef AUDIO_RESAMPLER_H
+#define AUDIO_RESAMPLER_H
+
+#include <stdint.h>
+
+#define RESAMPLER_MAX_TAPS 64
+#define RESAMPLER_MAX_PHASES 1024
+#define RESAMPLER_MAX_INPUT 256
+
+typedef enum {
+    AUDIO_RESAMPLE_FAST,
+    AUDIO_RESAMPLE_GOOD,
+    AUDIO_RESAMPLE_BEST
+} AudioResampleQuality;
+
+// Rational polyphase resampler. The rate ratio is reduced to out/in = L/M
+// and each of the L phases gets its own Kaiser-windowed sinc kernel, so
+// every output sample is one taps-long dot product. Output lags the input
+// by taps / 2 input samples.
+typedef struct {
+    float* kernels;
+    uint32_t taps;
+    uint32_t phases;
+    uint32_t step;
+    uint32_t phase;
+    int32_t offset;
+    float history[RESAMPLER_MAX_TAPS];
+    float work[RESAMPLER_MAX_TAPS + RESAMPLER_MAX_INPUT];
+} AudioResampler;
+
+int audio_resampler_init(AudioResampler* resampler, uint32_t in_rate, uint32_t out_rate, AudioResampleQuality quality);
+void audio_resampler_free(AudioResampler* resampler);
+uint32_t audio_resampler_input_needed(const AudioResampler* resampler, uint32_t out_count);
+void audio_resampler_process(AudioResampler* resampler, const float* input, uint32_t in_count, float* output, uint32_t out_count);
+uint32_t audio_resampler_latency(const AudioResampler* resampler);
+
+#endif
@@ -0,0 +1,159 @@
+#include "audio_reverb.h"
+#include "audio_simd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Mutually prime line lengths at 44.1 kHz, 24-65 ms
+static const uint32_t reverb_lengths[REVERB_LINES] = {1051, 1327, 1523, 1787, 1999, 2281, 2539, 2857};
+
+int audio_reverb_init(AudioReverb* reverb, float sample_rate, float decay_seconds, float damping, float wet) {
+    float scale = sample_rate / 44100.0f;
+    uint32_t longest = 0;
+    
+    for (int l = 0; l < REVERB_LINES; l++) {
+        uint32_t length = (uint32_t)((float)reverb_lengths[l] * scale);
+        if (length < 1) length = 1;
+        reverb->length[l] = length;
+        if (length > longest) longest = length;
+        
+        // Per-line gain for a 60 dB decay over decay_seconds
+        reverb->feedback[l] = powf(10.0f, -3.0f * (float)length / (decay_seconds * sample_rate));
+    }
+    
+    uint32_t size = 1;
+    while (size <= longest) {
+        size <<= 1;
+    }
+    
+    reverb->lines = malloc((size_t)size * REVERB_LINES * sizeof(float));
+    if (!reverb->lines) {
+        fprintf(stderr, "Failed to allocate reverb delay lines\n");
+        return -1;
+    }
+    
+    reverb->line_size = size;
+    reverb->mask = size - 1;
+    reverb->damping = damping;
+    reverb->input_gain = 0.35f;
+    reverb->wet = wet;
+    audio_reverb_clear(reverb);
+    return 0;
+}
+
+void audio_reverb_free(AudioReverb* reverb) {
+    free(reverb->lines);
+    reverb->lines = NULL;
+}
+
+void audio_reverb_clear(AudioReverb* reverb) {
+    if (reverb->lines) {
+        memset(reverb->lines, 0, (size_t)reverb->line_size * REVERB_LINES * sizeof(float));
+    }
+    memset(reverb->lowpass, 0, sizeof(reverb->lowpass));
+    reverb->pos = 0;
+}
+
+#ifdef AUDIO_SIMD_SSE
+// In-register 4-point Walsh-Hadamard transform
+static inline __m128 reverb_hadamard4(__m128 x) {
+    const __m128 sign_hi = _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f);
+    const __m128 sign_odd = _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f);
+    x = _mm_add_ps(_mm_movelh_ps(x, x), _mm_mul_ps(_mm_movehl_ps(x, x), sign_hi));
+    return _mm_add_ps(_mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 2, 0, 0)),
+                      _mm_mul_ps(_mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 1, 1)), sign_odd));
+}
+#endif
+
+void audio_reverb_process(AudioReverb* reverb, const float* input, float* output, uint32_t count) {
+    float* lines = reverb->lines;
+    uint32_t size = reverb->line_size;
+    uint32_t mask = reverb->mask;
+    uint32_t pos = reverb->pos;
+    float wet = reverb->wet;
+    float input_gain = reverb->input_gain;
+    // Unitary 8x8 Hadamard, so the loop gain is set by the feedback alone
+    const float norm = 0.35355339f;
+    float taps[REVERB_LINES];
+    float mixed[REVERB_LINES];
+    
+    if (!lines) {
+        if (output != input) {
+            memmove(output, input, count * sizeof(float));
+        }
+        return;
+    }
+
+#ifdef AUDIO_SIMD_SSE
+    __m128 damp = _mm_set1_ps(reverb->damping);
+    __m128 gain_lo = _mm_mul_ps(_mm_loadu_ps(reverb->feedback), _mm_set1_ps(1.0f - reverb->damping));
+    __m128 gain_hi = _mm_mul_ps(_mm_loadu_ps(reverb->feedback + 4), _mm_set1_ps(1.0f - reverb->damping));
+    __m128 lp_lo = _mm_loadu_ps(reverb->lowpass);
+    __m128 lp_hi = _mm_loadu_ps(reverb->lowpass + 4);
+    __m128 scale = _mm_set1_ps(norm);
+#else
+    float gain[REVERB_LINES];
+    for (int l = 0; l < REVERB_LINES; l++) {
+        gain[l] = reverb->feedback[l] * (1.0f - reverb->damping);
+    }
+#endif
+    
+    for (uint32_t i = 0; i < count; i++) {
+        float x = input[i];
+        float sum;
+        
+        for (int l = 0; l < REVERB_LINES; l++) {
+            taps[l] = lines[l * size + ((pos - reverb->length[l]) & mask)];
+        }
+
+#ifdef AUDIO_SIMD_SSE
+        lp_lo = _mm_add_ps(_mm_mul_ps(lp_lo, damp), _mm_mul_ps(_mm_loadu_ps(taps), gain_lo));
+        lp_hi = _mm_add_ps(_mm_mul_ps(lp_hi, damp), _mm_mul_ps(_mm_loadu_ps(taps + 4), gain_hi));
+        
+        __m128 total = _mm_add_ps(lp_lo, lp_hi);
+        total = _mm_add_ps(total, _mm_movehl_ps(total, total));
+        total = _mm_add_ss(total, _mm_shuffle_ps(total, total, _MM_SHUFFLE(1, 1, 1, 1)));
+        sum = _mm_cvtss_f32(total);
+        
+        __m128 in = _mm_set1_ps(x * input_gain);
+        _mm_storeu_ps(mixed, _mm_add_ps(_mm_mul_ps(reverb_hadamard4(_mm_add_ps(lp_lo, lp_hi)), scale), in));
+        _mm_storeu_ps(mixed + 4, _mm_add_ps(_mm_mul_ps(reverb_hadamard4(_mm_sub_ps(lp_lo, lp_hi)), scale), in));
+#else
+        float* lp = reverb->lowpass;
+        sum = 0.0f;
+        for (int l = 0; l < REVERB_LINES; l++) {
+            lp[l] = lp[l] * reverb->damping + taps[l] * gain[l];
+            sum += lp[l];
+            mixed[l] = lp[l];
+        }
+        
+        for (int span = 1; span < REVERB_LINES; span <<= 1) {
+            for (int j = 0; j < REVERB_LINES; j += span * 2) {
+                for (int k = j; k < j + span; k++) {
+                    float a = mixed[k];
+                    float b = mixed[k + span];
+                    mixed[k] = a + b;
+                    mixed[k + span] = a - b;
+                }
+            }
+        }
+        for (int l = 0; l < REVERB_LINES; l++) {
+            mixed[l] = mixed[l] * norm + x * input_gain;
+        }
+#endif
+        
+        for (int l = 0; l < REVERB_LINES; l++) {
+            lines[l * size + (pos & mask)] = mixed[l];
+        }
+        pos++;
+        
+        output[i] = x + sum * norm * wet;
+    }
+
+#ifdef AUDIO_SIMD_SSE
+    _mm_storeu_ps(reverb->lowpass, lp_lo);
+    _mm_storeu_ps(reverb->lowpass + 4, lp_hi);
+#endif
+    reverb->pos = pos;
+}
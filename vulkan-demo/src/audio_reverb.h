@@ -0,0 +1,30 @@
+#ifndef AUDIO_REVERB_H
+#define AUDIO_REVERB_H
+
+#include <stdint.h>
+
+#define REVERB_LINES 8
+
+// Feedback delay network reverb: eight delay lines fed back through a
+// normalized Hadamard matrix, each with a one-pole damping filter in the
+// loop. Every line lives in its own power-of-two slice of one allocation so
+// reads and writes wrap with a mask.
+typedef struct {
+    float* lines;
+    uint32_t line_size;
+    uint32_t mask;
+    uint32_t pos;
+    uint32_t length[REVERB_LINES];
+    float feedback[REVERB_LINES];
+    float lowpass[REVERB_LINES];
+    float damping;
+    float input_gain;
+    float wet;
+} AudioReverb;
+
+int audio_reverb_init(AudioReverb* reverb, float sample_rate, float decay_seconds, float damping, float wet);
+void audio_reverb_free(AudioReverb* reverb);
+void audio_reverb_clear(AudioReverb* reverb);
+void audio_reverb_process(AudioReverb* reverb, const float* input, float* output, uint32_t count);
+
+#endif
@@ -0,0 +1,81 @@
+#include "audio_sidechain.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define SIDECHAIN_THRESHOLD 0.01f
+#define SIDECHAIN_RATIO 4.0f
+#define SIDECHAIN_ATTACK_MS 0.5f
+#define SIDECHAIN_RELEASE_MS 150.0f
+
+int audio_sidechain_init(AudioSidechain* sidechain, float sample_rate, float max_seconds) {
+    uint32_t capacity = (uint32_t)(max_seconds * sample_rate);
+    
+    sidechain->curves = malloc(capacity * AUDIO_BUS_COUNT * sizeof(float));
+    sidechain->key = malloc(capacity * sizeof(float));
+    if (!sidechain->curves || !sidechain->key) {
+        fprintf(stderr, "Failed to allocate sidechain curves\n");
+        audio_sidechain_free(sidechain);
+        return -1;
+    }
+    
+    sidechain->capacity = capacity;
+    sidechain->curve_length = 0;
+    sidechain->pos = 0;
+    sidechain->depth[AUDIO_BUS_DRUMS] = 0.0f;
+    sidechain->depth[AUDIO_BUS_BASS] = 1.0f;
+    sidechain->depth[AUDIO_BUS_LEAD] = 0.5f;
+    sidechain->threshold = SIDECHAIN_THRESHOLD;
+    sidechain->ratio = SIDECHAIN_RATIO;
+    sidechain->attack_coef = 1.0f - expf(-1.0f / (SIDECHAIN_ATTACK_MS * 0.001f * sample_rate));
+    sidechain->release_coef = 1.0f - expf(-1.0f / (SIDECHAIN_RELEASE_MS * 0.001f * sample_rate));
+    sidechain->key_frequency = 0.0f;
+    sidechain->key_amplitude = 0.0f;
+    return 0;
+}
+
+void audio_sidechain_free(AudioSidechain* sidechain) {
+    free(sidechain->curves);
+    free(sidechain->key);
+    sidechain->curves = NULL;
+    sidechain->key = NULL;
+    sidechain->capacity = 0;
+    sidechain->curve_length = 0;
+    sidechain->pos = 0;
+}
+
+// Runs the envelope follower and gain computer over key[0..key_length) and
+// the silence after it, stopping once every bus is back within 0.1% of unity
+void audio_sidechain_build(AudioSidechain* sidechain, uint32_t key_length) {
+    float envelope = 0.0f;
+    float exponent = 1.0f / sidechain->ratio - 1.0f;
+    uint32_t length = 0;
+    
+    for (uint32_t n = 0; n < sidechain->capacity; n++) {
+        float level = (n < key_length) ? fabsf(sidechain->key[n]) : 0.0f;
+        float coef = (level > envelope) ? sidechain->attack_coef : sidechain->release_coef;
+        envelope += coef * (level - envelope);
+        
+        float gain = 1.0f;
+        if (envelope > sidechain->threshold) {
+            gain = powf(envelope / sidechain->threshold, exponent);
+        }
+        
+        float* frame = sidechain->curves + n * AUDIO_BUS_COUNT;
+        for (int b = 0; b < AUDIO_BUS_COUNT; b++) {
+            frame[b] = 1.0f - sidechain->depth[b] * (1.0f - gain);
+        }
+        
+        length = n + 1;
+        if (n >= key_length && gain > 0.999f) {
+            break;
+        }
+    }
+    
+    sidechain->curve_length = length;
+    sidechain->pos = length;
+}
+
+void audio_sidechain_reset(AudioSidechain* sidechain) {
+    sidechain->pos = sidechain->curve_length;
+}
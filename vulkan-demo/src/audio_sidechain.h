@@ -0,0 +1,49 @@
+#ifndef AUDIO_SIDECHAIN_H
+#define AUDIO_SIDECHAIN_H
+
+#include <stdint.h>
+
+typedef enum {
+    AUDIO_BUS_DRUMS,
+    AUDIO_BUS_BASS,
+    AUDIO_BUS_LEAD,
+    AUDIO_BUS_COUNT
+} AudioBus;
+
+// Sidechain ducker keyed from a single voice. The key voice is deterministic
+// per trigger, so the compressor runs once over its rendered output and the
+// resulting gain curves are replayed on every trigger. Curves are interleaved
+// [frame][bus]; a bus with depth 0 stays at unity.
+typedef struct {
+    float* curves;
+    float* key;
+    uint32_t capacity;
+    uint32_t curve_length;
+    uint32_t pos;
+    float depth[AUDIO_BUS_COUNT];
+    float threshold;
+    float ratio;
+    float attack_coef;
+    float release_coef;
+    // Key voice parameters the current curves were rendered for
+    float key_frequency;
+    float key_amplitude;
+} AudioSidechain;
+
+int audio_sidechain_init(AudioSidechain* sidechain, float sample_rate, float max_seconds);
+void audio_sidechain_free(AudioSidechain* sidechain);
+void audio_sidechain_build(AudioSidechain* sidechain, uint32_t key_length);
+void audio_sidechain_reset(AudioSidechain* sidechain);
+
+static inline void audio_sidechain_trigger(AudioSidechain* sidechain) {
+    sidechain->pos = 0;
+}
+
+// Bus nodes read the curves at pos in place; the renderer advances pos
+// after each block
+static inline void audio_sidechain_advance(AudioSidechain* sidechain, uint32_t count) {
+    uint32_t pos = sidechain->pos + count;
+    sidechain->pos = (pos < sidechain->curve_length) ? pos : sidechain->curve_length;
+}
+
+#endif
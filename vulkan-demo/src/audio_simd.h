@@ -0,0 +1,11 @@
+#ifndef AUDIO_SIMD_H
+#define AUDIO_SIMD_H
+
+// SSE is part of the x86-64 baseline; other targets take the scalar paths.
+// Define AUDIO_NO_SIMD to force the scalar code for comparison.
+#if !defined(AUDIO_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define AUDIO_SIMD_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#endif
@@ -1,16 +1,206 @@
 #include "audio_synthesis.h"
+#include "platform.h"
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #define PI 3.14159265359f
 #define TWO_PI (2.0f * PI)
 
+#define LIMITER_LOOKAHEAD_MS 5.0f
+#define LIMITER_RELEASE_MS 80.0f
+#define LIMITER_CEILING 0.7f
+
+#define SIDECHAIN_MAX_SECONDS 0.5f
+
+#define REVERB_DECAY_SECONDS 1.8f
+#define REVERB_DAMPING 0.35f
+#define REVERB_WET 0.25f
+
+#define HALL_SECONDS 2.0f
+#define HALL_WET 0.08f
+
+#define AUDIO_DEFAULT_OVERSAMPLE 2
+
+// Step down as soon as the smoothed load passes LOD_DOWN_LOAD; step back up
+// only after it has stayed under LOD_UP_LOAD for LOD_HOLD_SECONDS
+#define LOD_DOWN_LOAD 0.6f
+#define LOD_UP_LOAD 0.3f
+#define LOD_HOLD_SECONDS 2.0f
+#define LOD_SETTLE_SECONDS 0.25f
+#define LOD_SMOOTHING 0.1f
+
+// Graph output slots: the realtime mix, the pre-effects mix and the stems
+#define AUDIO_OUT_MASTER 0
+#define AUDIO_OUT_DRY 1
+#define AUDIO_OUT_STEMS 2
+
+// Song tables. Hashed together with AUDIO_SYNTH_VERSION to key the render cache.
+static const struct {
+    float a_minor[7];
+    float chord_roots[4];
+    int arp_pattern[8];
+    int bass_pattern[8];
+    int melody_notes[12];
+    int lead_notes[12];
+    int build_bass_pattern[8];
+    int build_arp_notes[4];
+    int final_lead_notes[16];
+} song = {
+    {220.0f, 246.94f, 261.63f, 293.66f, 329.63f, 349.23f, 392.0f},
+    {220.0f, 174.61f, 261.63f, 196.0f},
+    {0, 3, 7, 12, 15, 12, 7, 3},
+    {0, 0, 7, 7, 3, 3, 10, 10},
+    {12, 14, 15, 17, 19, 17, 15, 14, 12, 10, 12, 15},
+    {19, 17, 15, 14, 12, 14, 15, 17, 19, 22, 19, 17},
+    {0, 0, 7, 7, 3, 3, 10, 7},
+    {0, 3, 7, 12},
+    {24, 22, 19, 17, 24, 26, 24, 22, 19, 17, 19, 22, 24, 27, 24, 22}
+};
+
+// Voices whose waveforms have hard edges are rendered oversampled; the
+// drive is a tanh stage after the envelope, 0 for voices without one
+static const bool voice_oversampled[4] = {false, true, false, true};
+static const float voice_drive[4] = {0.0f, 0.0f, 2.0f, 2.5f};
+
+// Quality per level of detail. oversample caps the configured factor and
+// hall_tail is the fraction of the hall impulse response convolved.
+static const struct {
+    uint32_t unison;
+    uint32_t oversample;
+    float hall_tail;
+    uint32_t voice_cap;
+} audio_lods[AUDIO_LOD_LEVELS] = {
+    {3, 4, 1.0f, 4},
+    {3, 2, 0.5f, 4},
+    {1, 1, 0.5f, 4},
+    {1, 1, 0.25f, 3}
+};
+
 static float lerp(float a, float b, float t) {
     return a + t * (b - a);
 }
 
 static void audio_update_sequencer(AudioEngine* engine, float dt);
+static void audio_render(AudioEngine* engine, const AudioGraphPlan* plan, uint32_t count, float* energy);
+static int audio_build_graph(AudioEngine* engine);
+static void audio_trigger_kick(AudioEngine* engine, float frequency, float amplitude);
+static void audio_filter_coefficients(const AudioEngine* engine, float cutoff, float resonance, float* c);
+
+static void audio_play_precalc(AudioEngine* engine, float* mono, uint32_t count) {
+    uint32_t pos = engine->play_frame;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        mono[i] = engine->pcm[pos];
+        if (++pos >= engine->pcm_frames) {
+            pos = 0;
+        }
+    }
+    engine->play_frame = pos;
+}
+
+static void audio_snapshot_precalc(AudioEngine* engine, uint32_t latency) {
+    float time = (float)engine->play_frame / engine->sequencer.sample_rate;
+    float delay = (float)latency / engine->sequencer.sample_rate;
+    time = (time > delay) ? time - delay : 0.0f;
+    float row_duration = 60.0f / (engine->sequencer.bpm * 4.0f);
+    int total_rows = (int)(time / row_duration);
+    
+    engine->snapshot.time = time;
+    engine->snapshot.ring_pos = engine->ring_write - latency;
+    engine->snapshot.current_pattern = (total_rows / 64) % 8;
+    engine->snapshot.current_row = total_rows % 64;
+    engine->snapshot.bpm = engine->sequencer.bpm;
+    engine->snapshot.bass_energy = audio_envelope_value(&engine->envelopes, AUDIO_STEM_KICK, AUDIO_ENV_RMS, time);
+    engine->snapshot.mid_energy = audio_envelope_value(&engine->envelopes, AUDIO_STEM_BASS, AUDIO_ENV_RMS, time);
+    engine->snapshot.high_energy = audio_envelope_value(&engine->envelopes, AUDIO_STEM_LEAD, AUDIO_ENV_RMS, time);
+}
+
+// Produces count <= AUDIO_BLOCK_SIZE mono samples at the engine rate, from
+// the precalculated song or the live graph, and feeds the analysis ring
+static void audio_produce(AudioEngine* engine, float* mono, uint32_t count, float* energy) {
+    uint32_t ring_pos = engine->ring_write;
+    
+    if (engine->pcm) {
+        audio_play_precalc(engine, mono, count);
+    } else {
+        engine->graph.outputs[AUDIO_OUT_MASTER] = mono;
+        audio_render(engine, &engine->live_plan, count, energy);
+        engine->graph.outputs[AUDIO_OUT_MASTER] = NULL;
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        engine->analysis_ring[ring_pos++ & (AUDIO_RING_SIZE - 1)] = mono[i];
+    }
+    atomic_store_u32(&engine->ring_write, ring_pos);
+}
+
+static void audio_apply_lod(AudioEngine* engine, uint32_t lod) {
+    uint32_t oversample = (engine->oversample < audio_lods[lod].oversample) ? engine->oversample : audio_lods[lod].oversample;
+    
+    engine->lod = lod;
+    engine->unison = audio_lods[lod].unison;
+    engine->voice_cap = audio_lods[lod].voice_cap;
+    if (engine->voice_oversamplers[0].factor != oversample) {
+        for (int i = 0; i < 4; i++) {
+            audio_oversampler_init(&engine->voice_oversamplers[i], oversample);
+            audio_oversampler_init(&engine->drive_oversamplers[i], oversample);
+        }
+    }
+    audio_convolver_set_tail(&engine->convolver, audio_lods[lod].hall_tail);
+}
+
+// Runs on the audio thread after every callback. Changes are recorded in the
+// stats and reported from audio_update().
+static void audio_track_load(AudioEngine* engine, double started, uint32_t frame_count) {
+    AudioStats* stats = &engine->stats;
+    float budget = (float)frame_count / (float)engine->device_rate;
+    float load = (float)(platform_time_seconds() - started) / budget;
+    
+    stats->callbacks++;
+    stats->load += LOD_SMOOTHING * (load - stats->load);
+    if (load > stats->peak_load) stats->peak_load = load;
+    
+    // Playing the precalculated song costs next to nothing
+    if (engine->lod_fixed || engine->pcm) {
+        return;
+    }
+    
+    uint32_t lod = engine->lod;
+    engine->lod_settle -= budget;
+    if (stats->load > LOD_DOWN_LOAD) {
+        engine->lod_calm = 0.0f;
+        if (lod + 1 < AUDIO_LOD_LEVELS && engine->lod_settle <= 0.0f) {
+            lod++;
+            stats->downgrades++;
+        }
+    } else if (stats->load < LOD_UP_LOAD && lod > 0) {
+        engine->lod_calm += budget;
+        if (engine->lod_calm >= LOD_HOLD_SECONDS) {
+            lod--;
+            stats->upgrades++;
+        }
+    } else {
+        engine->lod_calm = 0.0f;
+    }
+    
+    if (lod != engine->lod) {
+        uint32_t count = stats->event_count;
+        AudioLodEvent* event = &stats->events[count % AUDIO_LOD_EVENTS];
+        event->time = engine->sequencer.time;
+        event->from = engine->lod;
+        event->to = lod;
+        event->load = stats->load;
+        atomic_store_u32(&stats->event_count, count + 1);
+        
+        audio_apply_lod(engine, lod);
+        stats->lod = lod;
+        engine->lod_calm = 0.0f;
+        // Give the smoothed load time to reflect the new level
+        engine->lod_settle = LOD_SETTLE_SECONDS;
+    }
+}
 
 static void audio_data_callback(void* pDevice, void* pOutput, const void* pInput, uint32_t frameCount) {
     ma_device* device = (ma_device*)pDevice;
@@ -19,48 +209,98 @@ static void audio_data_callback(void* pDevice, void* pOutput, const void* pInput
     
     (void)pInput;
     
+    double started = platform_time_seconds();
     float dt_per_sample = 1.0f / engine->sequencer.sample_rate;
-    float bass_sum = 0.0f;
-    float mid_sum = 0.0f;
-    float high_sum = 0.0f;
+    float energy[3] = {0.0f, 0.0f, 0.0f};
+    uint32_t rendered = 0;
+    float block[AUDIO_BLOCK_SIZE];
+    float resampled[AUDIO_BLOCK_SIZE];
     
-    for (ma_uint32 i = 0; i < frameCount; i++) {
-        audio_update_sequencer(engine, dt_per_sample);
+    for (ma_uint32 start = 0; start < frameCount; ) {
+        uint32_t count = frameCount - start;
+        if (count > AUDIO_BLOCK_SIZE) count = AUDIO_BLOCK_SIZE;
+        const float* mono = block;
         
-        float sample = audio_generate_sample(engine);
-        pOutputF32[i*2 + 0] = sample;
-        pOutputF32[i*2 + 1] = sample;
+        if (engine->resampling) {
+            // Largest output chunk whose input still fits one engine block
+            AudioResampler* resampler = &engine->resampler;
+            uint32_t limit = (uint32_t)((uint64_t)(AUDIO_BLOCK_SIZE - resampler->taps) * resampler->phases / resampler->step);
+            if (count > limit) count = limit;
+            while (audio_resampler_input_needed(resampler, count) > AUDIO_BLOCK_SIZE) {
+                count--;
+            }
+            
+            uint32_t in_count = audio_resampler_input_needed(resampler, count);
+            audio_produce(engine, block, in_count, energy);
+            audio_resampler_process(resampler, block, in_count, resampled, count);
+            rendered += in_count;
+            mono = resampled;
+        } else {
+            audio_produce(engine, block, count, energy);
+            rendered += count;
+        }
         
-        float abs_sample = fabsf(sample);
-        if (engine->oscillators[0].amplitude > 0.01f) bass_sum += abs_sample;
-        if (engine->oscillators[2].amplitude > 0.01f) mid_sum += abs_sample;
-        if (engine->oscillators[3].amplitude > 0.01f) high_sum += abs_sample;
+        float* out = pOutputF32 + start * 2;
+        for (uint32_t i = 0; i < count; i++) {
+            out[i*2 + 0] = mono[i];
+            out[i*2 + 1] = mono[i];
+        }
+        start += count;
     }
+    audio_track_load(engine, started, frameCount);
+    
+    // The cached render is already compensated for the limiter
+    uint32_t latency = engine->resampling ? audio_resampler_latency(&engine->resampler) : 0;
+    // The buffer starts rendered frames before what the snapshot holds, and
+    // is heard only once the device buffer queued ahead of it has played
+    double buffer_start = -(double)rendered / engine->sequencer.sample_rate - (double)frameCount / engine->device_rate;
+    if (engine->pcm) {
+        audio_snapshot_precalc(engine, latency);
+        audio_clock_publish(&engine->clock, started, engine->snapshot.time + buffer_start);
+        return;
+    }
+    // The ring holds the limiter's output, so only the resampler delays it
+    engine->snapshot.ring_pos = engine->ring_write - latency;
+    latency += audio_limiter_latency(&engine->limiter);
     
     for (int i = 0; i < 4; i++) {
         engine->snapshot.oscillators[i] = engine->oscillators[i];
     }
+    // What is audible lags the sequencer by the limiter's lookahead and the
+    // resampler's filter delay
+    engine->snapshot.time = engine->sequencer.time - (float)latency * dt_per_sample;
     engine->snapshot.current_pattern = engine->sequencer.current_pattern;
     engine->snapshot.current_row = engine->sequencer.current_row;
     engine->snapshot.bpm = engine->sequencer.bpm;
-    engine->snapshot.bass_energy = bass_sum / (float)frameCount;
-    engine->snapshot.mid_energy = mid_sum / (float)frameCount;
-    engine->snapshot.high_energy = high_sum / (float)frameCount;
+    if (rendered > 0) {
+        engine->snapshot.bass_energy = energy[0] / (float)rendered;
+        engine->snapshot.mid_energy = energy[1] / (float)rendered;
+        engine->snapshot.high_energy = energy[2] / (float)rendered;
+    }
+    audio_clock_publish(&engine->clock, started, engine->snapshot.time + buffer_start);
 }
 
-void audio_init(AudioEngine* engine, float sample_rate) {
-    engine->sequencer.sample_rate = sample_rate;
+static void audio_reset_voices(AudioEngine* engine) {
+    audio_limiter_init(&engine->limiter, engine->sequencer.sample_rate, LIMITER_LOOKAHEAD_MS, LIMITER_RELEASE_MS, LIMITER_CEILING);
+    audio_sidechain_reset(&engine->sidechain);
+    audio_reverb_clear(&engine->reverb);
+    audio_convolver_clear(&engine->convolver);
+    for (int i = 0; i < 4; i++) {
+        audio_oversampler_reset(&engine->voice_oversamplers[i]);
+        audio_oversampler_reset(&engine->drive_oversamplers[i]);
+    }
     engine->sequencer.time = 0.0f;
     engine->sequencer.bpm = 140.0f;
     engine->sequencer.playing = true;
     engine->sequencer.current_pattern = 0;
     engine->sequencer.current_row = 0;
     engine->sequencer.pattern_time = 0.0f;
+    memset(&engine->timeline_cursor, 0, sizeof(engine->timeline_cursor));
+    timeline_query(engine->timeline, &engine->timeline_cursor, 0.0f, &engine->scene);
     engine->master_volume = 0.5f;
     engine->filter_cutoff = 2000.0f;
     engine->filter_resonance = 0.5f;
     engine->filter_env = 0.0f;
-    engine->device_initialized = false;
     engine->filter_state = 0.0f;
     engine->hihat_accumulator = 0.0f;
     engine->filter_x1 = 0.0f;
@@ -74,21 +314,119 @@ void audio_init(AudioEngine* engine, float sample_rate) {
         engine->oscillators[i].phase = 0.0f;
         engine->oscillators[i].phase_increment = 0.0f;
     }
+}
+
+void audio_init(AudioEngine* engine, float sample_rate) {
+    engine->sequencer.sample_rate = sample_rate;
+    engine->timeline = timeline_demo();
+    engine->device_initialized = false;
+    engine->device_rate = (uint32_t)sample_rate;
+    engine->resampler.kernels = NULL;
+    engine->resampling = false;
+    engine->pcm = NULL;
+    engine->pcm_frames = 0;
+    engine->play_frame = 0;
+    engine->envelopes.values = NULL;
+    engine->envelopes.frame_count = 0;
+    engine->envelopes.frame_rate = sample_rate / (float)AUDIO_ENV_HOP;
+    engine->pcm_storage = NULL;
+    engine->envelope_storage = NULL;
+    engine->cache_mapping.data = NULL;
+    engine->cache_mapping.size = 0;
+    memset(engine->analysis_ring, 0, sizeof(engine->analysis_ring));
+    engine->ring_write = 0;
+    audio_clock_reset(&engine->clock);
+    if (audio_spectrum_init(&engine->spectrum) != 0) {
+        fprintf(stderr, "WARNING: Spectrum analyzer unavailable\n");
+    }
+    if (audio_sidechain_init(&engine->sidechain, sample_rate, SIDECHAIN_MAX_SECONDS) != 0) {
+        fprintf(stderr, "WARNING: Sidechain ducking disabled\n");
+    }
+    if (audio_reverb_init(&engine->reverb, sample_rate, REVERB_DECAY_SECONDS, REVERB_DAMPING, REVERB_WET) != 0) {
+        fprintf(stderr, "WARNING: Reverb disabled\n");
+    }
+    uint32_t hall_length = (uint32_t)(HALL_SECONDS * sample_rate);
+    float* hall = malloc(hall_length * sizeof(float));
+    if (hall) {
+        audio_convolver_make_hall(hall, hall_length, sample_rate, HALL_SECONDS);
+    }
+    if (!hall || audio_convolver_init(&engine->convolver, hall, hall_length, HALL_WET) != 0) {
+        fprintf(stderr, "WARNING: Hall convolution disabled\n");
+    }
+    free(hall);
+    
+    const char* oversample = getenv("DEMO_AUDIO_OVERSAMPLE");
+    engine->oversample = oversample ? (uint32_t)atoi(oversample) : AUDIO_DEFAULT_OVERSAMPLE;
+    for (int i = 0; i < 4; i++) {
+        audio_oversampler_init(&engine->voice_oversamplers[i], engine->oversample);
+        audio_oversampler_init(&engine->drive_oversamplers[i], engine->oversample);
+    }
+    engine->oversample = engine->voice_oversamplers[0].factor;
+    
+    // DEMO_AUDIO_LOD pins a level and turns adaptation off
+    const char* lod = getenv("DEMO_AUDIO_LOD");
+    memset(&engine->stats, 0, sizeof(engine->stats));
+    engine->lod_fixed = lod && atoi(lod) >= 0 && atoi(lod) < AUDIO_LOD_LEVELS;
+    engine->lod_calm = 0.0f;
+    engine->lod_settle = 0.0f;
+    engine->lod_events_reported = 0;
+    audio_apply_lod(engine, engine->lod_fixed ? (uint32_t)atoi(lod) : 0);
+    engine->stats.lod = engine->lod;
+    
+    // Node-level parallelism only pays off with heavy graphs, so workers
+    // are opt-in
+    const char* threads = getenv("DEMO_AUDIO_THREADS");
+    audio_graph_init(&engine->graph);
+    if (threads && atoi(threads) > 0 && audio_graph_start_workers(&engine->graph, (uint32_t)atoi(threads)) != 0) {
+        fprintf(stderr, "WARNING: Audio graph workers unavailable\n");
+    }
+    if (audio_build_graph(engine) != 0) {
+        fprintf(stderr, "WARNING: Audio graph failed to compile\n");
+    }
+    audio_reset_voices(engine);
     
+    engine->snapshot.time = 0.0f;
     engine->snapshot.bass_energy = 0.0f;
     engine->snapshot.mid_energy = 0.0f;
     engine->snapshot.high_energy = 0.0f;
 }
 
 void audio_update(AudioEngine* engine, float dt) {
-    (void)engine;
+    uint32_t count = atomic_load_u32(&engine->stats.event_count);
     (void)dt;
+    
+    // LOD changes are logged here because the callback must not block on
+    // stdio. Events overwritten before we got to them are skipped.
+    if (count - engine->lod_events_reported > AUDIO_LOD_EVENTS) {
+        engine->lod_events_reported = count - AUDIO_LOD_EVENTS;
+    }
+    while (engine->lod_events_reported != count) {
+        const AudioLodEvent* event = &engine->stats.events[engine->lod_events_reported % AUDIO_LOD_EVENTS];
+        printf("Audio LOD %u -> %u at %.2fs (load %.0f%%)\n", event->from, event->to, event->time, event->load * 100.0f);
+        engine->lod_events_reported++;
+    }
+}
+
+void audio_get_stats(AudioEngine* engine, AudioStats* stats) {
+    const AudioStats* source = &engine->stats;
+    stats->event_count = atomic_load_u32(&source->event_count);
+    stats->lod = source->lod;
+    stats->callbacks = source->callbacks;
+    stats->load = source->load;
+    stats->peak_load = source->peak_load;
+    stats->downgrades = source->downgrades;
+    stats->upgrades = source->upgrades;
+    for (int i = 0; i < AUDIO_LOD_EVENTS; i++) {
+        stats->events[i] = source->events[i];
+    }
 }
 
 void audio_get_snapshot(AudioEngine* engine, AudioSnapshot* snapshot) {
     for (int i = 0; i < 4; i++) {
         snapshot->oscillators[i] = engine->snapshot.oscillators[i];
     }
+    snapshot->time = engine->snapshot.time;
+    snapshot->ring_pos = engine->snapshot.ring_pos;
     snapshot->current_pattern = engine->snapshot.current_pattern;
     snapshot->current_row = engine->snapshot.current_row;
     snapshot->bpm = engine->snapshot.bpm;
@@ -97,6 +435,158 @@ void audio_get_snapshot(AudioEngine* engine, AudioSnapshot* snapshot) {
     snapshot->high_energy = engine->snapshot.high_energy;
 }
 
+int audio_precalc(AudioEngine* engine, float seconds) {
+    float sample_rate = engine->sequencer.sample_rate;
+    uint32_t env_frames = (uint32_t)(seconds * sample_rate) / AUDIO_ENV_HOP;
+    uint32_t frames = env_frames * AUDIO_ENV_HOP;
+    uint32_t track_count = AUDIO_ENV_KIND_COUNT * AUDIO_STEM_COUNT;
+    
+    if (env_frames == 0) {
+        return -1;
+    }
+    
+    float* pcm = malloc(frames * sizeof(float));
+    float* env = malloc(track_count * env_frames * sizeof(float));
+    uint8_t* storage = malloc(track_count * env_frames);
+    if (!pcm || !env || !storage) {
+        fprintf(stderr, "Failed to allocate %u frames for audio precalc\n", frames);
+        free(pcm);
+        free(env);
+        free(storage);
+        return -1;
+    }
+    
+    // The song is rendered once and cached, so always at full quality; a
+    // pinned DEMO_AUDIO_LOD only applies to live rendering
+    uint32_t live_lod = engine->lod;
+    audio_apply_lod(engine, 0);
+    audio_reset_voices(engine);
+    
+    float stems[AUDIO_STEM_COUNT][AUDIO_ENV_HOP];
+    for (int s = 0; s < AUDIO_STEM_COUNT; s++) {
+        engine->graph.outputs[AUDIO_OUT_STEMS + s] = stems[s];
+    }
+    
+    for (uint32_t f = 0; f < env_frames; f++) {
+        float sum_sq[AUDIO_STEM_COUNT] = {0};
+        float peak[AUDIO_STEM_COUNT] = {0};
+        
+        engine->graph.outputs[AUDIO_OUT_DRY] = pcm + f * AUDIO_ENV_HOP;
+        audio_render(engine, &engine->precalc_plan, AUDIO_ENV_HOP, NULL);
+        
+        for (int s = 0; s < AUDIO_STEM_COUNT; s++) {
+            for (uint32_t i = 0; i < AUDIO_ENV_HOP; i++) {
+                float a = fabsf(stems[s][i]);
+                sum_sq[s] += a * a;
+                if (a > peak[s]) peak[s] = a;
+            }
+        }
+        
+        for (int s = 0; s < AUDIO_STEM_COUNT; s++) {
+            float rms = sqrtf(sum_sq[s] / (float)AUDIO_ENV_HOP);
+            float prev = (f > 0) ? env[(AUDIO_ENV_RMS * AUDIO_STEM_COUNT + s) * env_frames + f - 1] : 0.0f;
+            
+            env[(AUDIO_ENV_RMS * AUDIO_STEM_COUNT + s) * env_frames + f] = rms;
+            env[(AUDIO_ENV_PEAK * AUDIO_STEM_COUNT + s) * env_frames + f] = peak[s];
+            env[(AUDIO_ENV_ONSET * AUDIO_STEM_COUNT + s) * env_frames + f] = (rms > prev) ? rms - prev : 0.0f;
+        }
+    }
+    for (int slot = 0; slot < AUDIO_GRAPH_MAX_OUTPUTS; slot++) {
+        engine->graph.outputs[slot] = NULL;
+    }
+    
+    float discard[LIMITER_BUFFER];
+    
+    // Run the end of the song through the reverbs first so their tails
+    // carry over the loop point into the opening bars
+    uint32_t tail = (uint32_t)(fmaxf(REVERB_DECAY_SECONDS, HALL_SECONDS) * sample_rate);
+    if (tail > frames) tail = frames;
+    for (uint32_t pos = frames - tail; pos < frames; pos += LIMITER_BUFFER) {
+        uint32_t count = (frames - pos < LIMITER_BUFFER) ? frames - pos : LIMITER_BUFFER;
+        audio_reverb_process(&engine->reverb, pcm + pos, discard, count);
+        audio_convolver_process(&engine->convolver, discard, discard, count);
+    }
+    audio_reverb_process(&engine->reverb, pcm, pcm, frames);
+    audio_convolver_process(&engine->convolver, pcm, pcm, frames);
+    
+    // The limiter delays its output by the lookahead. Feeding the song's
+    // opening samples again at the end both flushes it and keeps the loop
+    // seamless, so pcm[n] stays aligned with song time n.
+    uint32_t latency = audio_limiter_latency(&engine->limiter);
+    float head[LIMITER_BUFFER];
+    memcpy(head, pcm, latency * sizeof(float));
+    audio_limiter_process(&engine->limiter, head, discard, latency);
+    audio_limiter_process(&engine->limiter, pcm + latency, pcm, frames - latency);
+    audio_limiter_process(&engine->limiter, head, pcm + frames - latency, latency);
+    
+    // Normalize every track to its own peak so visuals get 0..1 per instrument
+    for (uint32_t t = 0; t < track_count; t++) {
+        const float* src = env + t * env_frames;
+        uint8_t* dst = storage + t * env_frames;
+        float max_value = 0.0f;
+        
+        for (uint32_t f = 0; f < env_frames; f++) {
+            if (src[f] > max_value) max_value = src[f];
+        }
+        
+        float scale = (max_value > 0.0f) ? 255.0f / max_value : 0.0f;
+        for (uint32_t f = 0; f < env_frames; f++) {
+            dst[f] = (uint8_t)(src[f] * scale + 0.5f);
+        }
+    }
+    free(env);
+    
+    audio_apply_lod(engine, live_lod);
+    audio_reset_voices(engine);
+    audio_release_song(engine);
+    
+    engine->pcm = pcm;
+    engine->pcm_frames = frames;
+    engine->play_frame = 0;
+    engine->pcm_storage = pcm;
+    engine->envelope_storage = storage;
+    engine->envelopes.values = storage;
+    engine->envelopes.frame_count = env_frames;
+    engine->envelopes.frame_rate = sample_rate / (float)AUDIO_ENV_HOP;
+    return 0;
+}
+
+uint64_t audio_song_hash(const AudioEngine* engine, float seconds) {
+    uint32_t params[5];
+    params[0] = AUDIO_SYNTH_VERSION;
+    params[1] = (uint32_t)engine->sequencer.sample_rate;
+    params[2] = (uint32_t)(seconds * 1000.0f);
+    params[3] = AUDIO_ENV_HOP;
+    // The factor precalc renders with, which is capped by LOD 0
+    params[4] = (engine->oversample < audio_lods[0].oversample) ? engine->oversample : audio_lods[0].oversample;
+    
+    // FNV-1a over the synth parameters followed by the song and scene tables
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const uint8_t* bytes = (const uint8_t*)params;
+    for (size_t i = 0; i < sizeof(params); i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    bytes = (const uint8_t*)&song;
+    for (size_t i = 0; i < sizeof(song); i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    bytes = (const uint8_t*)engine->timeline->scenes;
+    for (size_t i = 0; i < engine->timeline->count * sizeof(TimelineScene); i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+float audio_envelope_value(const AudioEnvelopeTracks* tracks, AudioStem stem, AudioEnvelopeKind kind, float time) {
+    if (!tracks->values || time < 0.0f) {
+        return 0.0f;
+    }
+    
+    uint32_t frame = (uint32_t)(time * tracks->frame_rate) % tracks->frame_count;
+    uint32_t track = (uint32_t)kind * AUDIO_STEM_COUNT + (uint32_t)stem;
+    return (float)tracks->values[track * tracks->frame_count + frame] * (1.0f / 255.0f);
+}
+
 static void audio_update_sequencer(AudioEngine* engine, float dt) {
     engine->sequencer.time += dt;
     
@@ -112,19 +602,18 @@ static void audio_update_sequencer(AudioEngine* engine, float dt) {
             engine->sequencer.current_pattern = (engine->sequencer.current_pattern + 1) % 8;
         }
         
-        int scene = (int)(engine->sequencer.time / 12.0f) % 5;
-        float scene_time = fmodf(engine->sequencer.time, 12.0f);
+        timeline_query(engine->timeline, &engine->timeline_cursor, engine->sequencer.time, &engine->scene);
+        int scene = engine->scene.scene;
+        float scene_time = engine->scene.local;
         int row = engine->sequencer.current_row;
         
-        float a_minor[] = {220.0f, 246.94f, 261.63f, 293.66f, 329.63f, 349.23f, 392.0f};
-        float chord_roots[] = {220.0f, 174.61f, 261.63f, 196.0f};
         int chord_idx = (row / 16) % 4;
-        float root = chord_roots[chord_idx];
+        float root = song.chord_roots[chord_idx];
         
         if (row % 4 == 0) {
             float kick_freq = 55.0f;
             if (scene >= 1) {
-                audio_note_on(&engine->oscillators[0], kick_freq, 0.8f);
+                audio_trigger_kick(engine, kick_freq, 0.8f);
             }
         }
         
@@ -134,10 +623,9 @@ static void audio_update_sequencer(AudioEngine* engine, float dt) {
         
         if (scene == 0) {
             if (row % 2 == 0) {
-                int arp_pattern[] = {0, 3, 7, 12, 15, 12, 7, 3};
                 int arp_step = (row / 2) % 8;
-                float arp_freq = root * powf(2.0f, (float)arp_pattern[arp_step] / 12.0f);
-                float amp = 0.12f + (scene_time / 12.0f) * 0.08f;
+                float arp_freq = root * powf(2.0f, (float)song.arp_pattern[arp_step] / 12.0f);
+                float amp = 0.12f + engine->scene.progress * 0.08f;
                 audio_note_on(&engine->oscillators[2], arp_freq, amp);
             }
             
@@ -152,16 +640,14 @@ static void audio_update_sequencer(AudioEngine* engine, float dt) {
         }
         else if (scene == 1) {
             if (row % 2 == 0) {
-                int bass_pattern[] = {0, 0, 7, 7, 3, 3, 10, 10};
-                int bass_note = bass_pattern[(row / 2) % 8];
+                int bass_note = song.bass_pattern[(row / 2) % 8];
                 float bass_freq = root * powf(2.0f, (float)bass_note / 12.0f) * 0.5f;
                 audio_note_on(&engine->oscillators[2], bass_freq, 0.38f);
             }
             
             if (row % 3 == 0) {
-                int melody_notes[] = {12, 14, 15, 17, 19, 17, 15, 14, 12, 10, 12, 15};
                 int melody_idx = (row / 3) % 12;
-                float melody_freq = a_minor[0] * powf(2.0f, (float)melody_notes[melody_idx] / 12.0f);
+                float melody_freq = song.a_minor[0] * powf(2.0f, (float)song.melody_notes[melody_idx] / 12.0f);
                 audio_note_on(&engine->oscillators[3], melody_freq, 0.22f);
             }
             
@@ -169,9 +655,8 @@ static void audio_update_sequencer(AudioEngine* engine, float dt) {
         }
         else if (scene == 2) {
             if (row % 3 == 0) {
-                int lead_notes[] = {19, 17, 15, 14, 12, 14, 15, 17, 19, 22, 19, 17};
                 int lead_idx = (row / 3) % 12;
-                float lead_freq = a_minor[0] * powf(2.0f, (float)lead_notes[lead_idx] / 12.0f);
+                float lead_freq = song.a_minor[0] * powf(2.0f, (float)song.lead_notes[lead_idx] / 12.0f);
                 audio_note_on(&engine->oscillators[2], lead_freq, 0.25f);
             }
             
@@ -186,17 +671,15 @@ static void audio_update_sequencer(AudioEngine* engine, float dt) {
         }
         else if (scene == 3) {
             if (row % 2 == 0) {
-                int bass_pattern[] = {0, 0, 7, 7, 3, 3, 10, 7};
-                int bass_note = bass_pattern[(row / 2) % 8];
+                int bass_note = song.build_bass_pattern[(row / 2) % 8];
                 float bass_freq = root * powf(2.0f, (float)bass_note / 12.0f) * 0.5f;
                 audio_note_on(&engine->oscillators[2], bass_freq, 0.42f);
             }
             
             if (row >= 32) {
                 if (row % 1 == 0) {
-                    int arp_notes[] = {0, 3, 7, 12};
                     int arp_idx = row % 4;
-                    float arp_freq = root * powf(2.0f, (float)arp_notes[arp_idx] / 12.0f) * 2.0f;
+                    float arp_freq = root * powf(2.0f, (float)song.build_arp_notes[arp_idx] / 12.0f) * 2.0f;
                     float amp = 0.15f + ((float)(row - 32) / 32.0f) * 0.15f;
                     audio_note_on(&engine->oscillators[3], arp_freq, amp);
                 }
@@ -211,16 +694,14 @@ static void audio_update_sequencer(AudioEngine* engine, float dt) {
         }
         else if (scene == 4) {
             if (row % 2 == 0) {
-                int bass_pattern[] = {0, 0, 7, 7, 3, 3, 10, 10};
-                int bass_note = bass_pattern[(row / 2) % 8];
+                int bass_note = song.bass_pattern[(row / 2) % 8];
                 float bass_freq = root * powf(2.0f, (float)bass_note / 12.0f) * 0.5f;
                 audio_note_on(&engine->oscillators[2], bass_freq, 0.48f);
             }
             
             if (row % 1 == 0) {
-                int lead_notes[] = {24, 22, 19, 17, 24, 26, 24, 22, 19, 17, 19, 22, 24, 27, 24, 22};
                 int lead_idx = row % 16;
-                float lead_freq = a_minor[0] * powf(2.0f, (float)lead_notes[lead_idx] / 12.0f);
+                float lead_freq = song.a_minor[0] * powf(2.0f, (float)song.final_lead_notes[lead_idx] / 12.0f);
                 float amp = 0.25f + ((float)row / 64.0f) * 0.15f;
                 audio_note_on(&engine->oscillators[3], lead_freq, amp);
             }
@@ -233,68 +714,355 @@ static void audio_update_sequencer(AudioEngine* engine, float dt) {
     }
 }
 
-float audio_generate_sample(AudioEngine* engine) {
-    float sample = 0.0f;
-    float sample_rate = engine->sequencer.sample_rate;
-    float dt = 1.0f / sample_rate;
+static float audio_voice_decay(int voice_index) {
+    return (voice_index == 0) ? 0.998f : (voice_index == 1) ? 0.992f : 0.9995f;
+}
+
+static float audio_rng_noise(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return (float)(*state >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+// Unit-amplitude waveform of a voice; advances its phase
+static float audio_voice_wave(Oscillator* osc, int voice_index, uint32_t unison, float dt, uint32_t* rng) {
+    float wave = 0.0f;
     
-    for (int i = 0; i < 4; i++) {
-        Oscillator* osc = &engine->oscillators[i];
-        
-        if (osc->amplitude > 0.0f) {
-            float wave = 0.0f;
-            
-            if (i == 0) {
-                float kick_phase = osc->phase * 0.3f;
-                wave = audio_sine(kick_phase) * expf(-osc->phase * 3.0f);
-            }
-            else if (i == 1) {
-                wave = audio_noise() * 0.5f + audio_square(osc->phase * 8.0f) * 0.5f;
-            }
-            else if (i == 2) {
-                float detune1 = audio_sawtooth(osc->phase);
-                float detune2 = audio_sawtooth(osc->phase + 0.02f);
-                float detune3 = audio_sawtooth(osc->phase - 0.02f);
-                wave = (detune1 + detune2 + detune3) / 3.0f;
-            }
-            else if (i == 3) {
-                float pw = 0.5f + 0.3f * audio_sine(osc->phase * 0.1f);
-                float pulse = (fmodf(osc->phase, TWO_PI) < (TWO_PI * pw)) ? 1.0f : -1.0f;
-                wave = pulse * 0.6f + audio_sine(osc->phase * 2.0f) * 0.4f;
-            }
-            
-            sample += wave * osc->amplitude;
-            
-            float phase_inc = TWO_PI * osc->phase_increment * dt;
-            osc->phase += phase_inc;
-            if (osc->phase >= TWO_PI) {
-                osc->phase -= TWO_PI;
-            }
-            
-            float decay_rate = (i == 0) ? 0.998f : (i == 1) ? 0.992f : 0.9995f;
-            osc->amplitude *= decay_rate;
-            if (osc->amplitude < 0.001f) {
-                osc->amplitude = 0.0f;
-            }
+    if (voice_index == 0) {
+        float kick_phase = osc->phase * 0.3f;
+        wave = audio_sine(kick_phase) * expf(-osc->phase * 3.0f);
+    }
+    else if (voice_index == 1) {
+        wave = audio_rng_noise(rng) * 0.5f + audio_square(osc->phase * 8.0f) * 0.5f;
+    }
+    else if (voice_index == 2) {
+        wave = audio_sawtooth(osc->phase);
+        if (unison > 1) {
+            float detune2 = audio_sawtooth(osc->phase + 0.02f);
+            float detune3 = audio_sawtooth(osc->phase - 0.02f);
+            wave = (wave + detune2 + detune3) / 3.0f;
+        }
+    }
+    else if (voice_index == 3) {
+        float pw = 0.5f + 0.3f * audio_sine(osc->phase * 0.1f);
+        float pulse = (fmodf(osc->phase, TWO_PI) < (TWO_PI * pw)) ? 1.0f : -1.0f;
+        wave = pulse * 0.6f + audio_sine(osc->phase * 2.0f) * 0.4f;
+    }
+    
+    float phase_inc = TWO_PI * osc->phase_increment * dt;
+    osc->phase += phase_inc;
+    if (osc->phase >= TWO_PI) {
+        osc->phase -= TWO_PI;
+    }
+    
+    return wave;
+}
+
+static void audio_trigger_kick(AudioEngine* engine, float frequency, float amplitude) {
+    AudioSidechain* sidechain = &engine->sidechain;
+    audio_note_on(&engine->oscillators[0], frequency, amplitude);
+    
+    if (!sidechain->curves) {
+        return;
+    }
+    
+    // The kick is the same every time it is struck with the same parameters,
+    // so its gain curves only need rendering when those change
+    if (sidechain->key_frequency != frequency || sidechain->key_amplitude != amplitude) {
+        float dt = 1.0f / engine->sequencer.sample_rate;
+        float decay = audio_voice_decay(0);
+        Oscillator key = engine->oscillators[0];
+        uint32_t key_length = 0;
+        while (key.amplitude > 0.0f && key_length < sidechain->capacity) {
+            sidechain->key[key_length++] = audio_voice_wave(&key, 0, 1, dt, NULL) * key.amplitude;
+            key.amplitude *= decay;
+            if (key.amplitude < 0.001f) key.amplitude = 0.0f;
         }
+        audio_sidechain_build(sidechain, key_length);
+        sidechain->key_frequency = frequency;
+        sidechain->key_amplitude = amplitude;
     }
+    audio_sidechain_trigger(sidechain);
+}
+
+// Graph node kernels. Per-block parameters come from the engine, which the
+// sequencer only changes between blocks.
+
+static void audio_node_oscillator(AudioNode* node, const float* const* inputs, float* output, uint32_t count) {
+    AudioEngine* engine = (AudioEngine*)node->state;
+    Oscillator* osc = &engine->oscillators[node->param];
+    float dt = 1.0f / engine->sequencer.sample_rate;
+    (void)inputs;
     
+    if (osc->amplitude <= 0.0f) {
+        memset(output, 0, count * sizeof(float));
+        audio_oversampler_reset(&engine->voice_oversamplers[node->param]);
+        return;
+    }
+    
+    AudioOversampler* os = &engine->voice_oversamplers[node->param];
+    if (voice_oversampled[node->param] && os->factor > 1) {
+        // Naive edges alias far less when stepped at the higher rate and
+        // band-limited on the way down
+        float fine[AUDIO_GRAPH_BLOCK * OVERSAMPLE_MAX_FACTOR];
+        uint32_t fine_count = count * os->factor;
+        float fine_dt = dt / (float)os->factor;
+        for (uint32_t i = 0; i < fine_count; i++) {
+            fine[i] = audio_voice_wave(osc, node->param, engine->unison, fine_dt, &node->rng);
+        }
+        audio_oversampler_downsample(os, fine, output, count);
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        output[i] = audio_voice_wave(osc, node->param, engine->unison, dt, &node->rng);
+    }
+}
+
+static void audio_node_envelope(AudioNode* node, const float* const* inputs, float* output, uint32_t count) {
+    AudioEngine* engine = (AudioEngine*)node->state;
+    Oscillator* osc = &engine->oscillators[node->param];
+    float decay = audio_voice_decay(node->param);
+    float amplitude = osc->amplitude;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        output[i] = inputs[0][i] * amplitude;
+        amplitude *= decay;
+        if (amplitude < 0.001f) amplitude = 0.0f;
+    }
+    osc->amplitude = amplitude;
+}
+
+static void audio_node_drive(AudioNode* node, const float* const* inputs, float* output, uint32_t count) {
+    AudioOversampler* os = &((AudioEngine*)node->state)->drive_oversamplers[node->param];
+    float drive = voice_drive[node->param];
+    float fine[AUDIO_GRAPH_BLOCK * OVERSAMPLE_MAX_FACTOR];
+    uint32_t fine_count = count * os->factor;
+    
+    // Pade approximation of tanh, exact at the +-3 clamp. Dividing by drive
+    // keeps small signals at unity gain, so drive only sets where it bends.
+    audio_oversampler_upsample(os, inputs[0], fine, count);
+    for (uint32_t i = 0; i < fine_count; i++) {
+        float x = drive * fine[i];
+        if (x > 3.0f) x = 3.0f;
+        if (x < -3.0f) x = -3.0f;
+        fine[i] = x * (27.0f + x * x) / (27.0f + 9.0f * x * x) / drive;
+    }
+    audio_oversampler_downsample(os, fine, output, count);
+}
+
+static void audio_node_ducked_bus(AudioNode* node, const float* const* inputs, float* output, uint32_t count) {
+    const AudioSidechain* sidechain = &((AudioEngine*)node->state)->sidechain;
+    uint32_t pos = sidechain->pos;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        float sum = 0.0f;
+        for (int j = 0; j < node->input_count; j++) {
+            sum += inputs[j][i];
+        }
+        float gain = (pos + i < sidechain->curve_length) ? sidechain->curves[(pos + i) * AUDIO_BUS_COUNT + node->param] : 1.0f;
+        output[i] = sum * gain;
+    }
+}
+
+static void audio_node_filter(AudioNode* node, const float* const* inputs, float* output, uint32_t count) {
+    AudioEngine* engine = (AudioEngine*)node->state;
     float cutoff = engine->filter_cutoff * (1.0f + engine->filter_env * 0.5f);
-    sample = audio_filter(engine, sample, cutoff, engine->filter_resonance);
+    float c[5];
     
+    audio_filter_coefficients(engine, cutoff, engine->filter_resonance, c);
+    for (uint32_t i = 0; i < count; i++) {
+        float input = inputs[0][i];
+        float y = c[0] * input + c[1] * engine->filter_x1 + c[2] * engine->filter_x2 - c[3] * engine->filter_y1 - c[4] * engine->filter_y2;
+        engine->filter_x2 = engine->filter_x1;
+        engine->filter_x1 = input;
+        engine->filter_y2 = engine->filter_y1;
+        engine->filter_y1 = y;
+        output[i] = y;
+    }
+}
+
+static void audio_node_hihat(AudioNode* node, const float* const* inputs, float* output, uint32_t count) {
+    AudioEngine* engine = (AudioEngine*)node->state;
     int row = engine->sequencer.current_row;
-    int scene = (int)(engine->sequencer.time / 12.0f) % 5;
+    int scene = engine->scene.scene;
+    (void)inputs;
+    
     if (scene >= 1 && (row % 2 == 1)) {
-        sample += audio_noise() * 0.04f * engine->filter_env;
+        float level = 0.04f * engine->filter_env;
+        for (uint32_t i = 0; i < count; i++) {
+            output[i] = audio_rng_noise(&node->rng) * level;
+        }
+    } else {
+        memset(output, 0, count * sizeof(float));
     }
+}
+
+static void audio_node_master(AudioNode* node, const float* const* inputs, float* output, uint32_t count) {
+    // Matches the small-signal level of the old tanh(1.2x) * 0.7 stage;
+    // peaks are left to the limiter
+    float gain = ((AudioEngine*)node->state)->master_volume * 0.8f * 0.84f;
     
-    sample *= engine->master_volume * 0.8f;
-    sample = tanhf(sample * 1.2f) * 0.7f;
+    for (uint32_t i = 0; i < count; i++) {
+        output[i] = (inputs[0][i] + inputs[1][i]) * gain;
+    }
+}
+
+static void audio_node_reverb(AudioNode* node, const float* const* inputs, float* output, uint32_t count) {
+    audio_reverb_process((AudioReverb*)node->state, inputs[0], output, count);
+}
+
+static void audio_node_convolver(AudioNode* node, const float* const* inputs, float* output, uint32_t count) {
+    audio_convolver_process((AudioConvolver*)node->state, inputs[0], output, count);
+}
+
+static void audio_node_limiter(AudioNode* node, const float* const* inputs, float* output, uint32_t count) {
+    audio_limiter_process((AudioLimiter*)node->state, inputs[0], output, count);
+}
+
+static int audio_build_graph(AudioEngine* engine) {
+    AudioGraph* graph = &engine->graph;
+    static const int voice_stems[4] = {AUDIO_STEM_KICK, AUDIO_STEM_SNARE, AUDIO_STEM_BASS, AUDIO_STEM_LEAD};
+    int voices[4];
+    int ok = 0;
+    
+    for (int i = 0; i < 4; i++) {
+        int osc = audio_graph_add(graph, AUDIO_NODE_OSCILLATOR, audio_node_oscillator, engine, i);
+        voices[i] = audio_graph_add(graph, AUDIO_NODE_ENVELOPE, audio_node_envelope, engine, i);
+        ok |= audio_graph_connect(graph, osc, voices[i]);
+        if (voice_drive[i] > 0.0f) {
+            int drive = audio_graph_add(graph, AUDIO_NODE_EFFECT, audio_node_drive, engine, i);
+            ok |= audio_graph_connect(graph, voices[i], drive);
+            voices[i] = drive;
+        }
+    }
+    
+    int drums = audio_graph_add(graph, AUDIO_NODE_BUS, NULL, NULL, 0);
+    int bass = audio_graph_add(graph, AUDIO_NODE_BUS, audio_node_ducked_bus, engine, AUDIO_BUS_BASS);
+    int lead = audio_graph_add(graph, AUDIO_NODE_BUS, audio_node_ducked_bus, engine, AUDIO_BUS_LEAD);
+    int mix = audio_graph_add(graph, AUDIO_NODE_BUS, NULL, NULL, 0);
+    int filter = audio_graph_add(graph, AUDIO_NODE_FILTER, audio_node_filter, engine, 0);
+    int hihat = audio_graph_add(graph, AUDIO_NODE_OSCILLATOR, audio_node_hihat, engine, 0);
+    int master = audio_graph_add(graph, AUDIO_NODE_BUS, audio_node_master, engine, 0);
+    int reverb = audio_graph_add(graph, AUDIO_NODE_EFFECT, audio_node_reverb, &engine->reverb, 0);
+    int hall = audio_graph_add(graph, AUDIO_NODE_EFFECT, audio_node_convolver, &engine->convolver, 0);
+    int limiter = audio_graph_add(graph, AUDIO_NODE_EFFECT, audio_node_limiter, &engine->limiter, 0);
+    int live_out = audio_graph_add(graph, AUDIO_NODE_OUTPUT, NULL, NULL, AUDIO_OUT_MASTER);
+    int dry_out = audio_graph_add(graph, AUDIO_NODE_OUTPUT, NULL, NULL, AUDIO_OUT_DRY);
+    
+    ok |= audio_graph_connect(graph, voices[0], drums);
+    ok |= audio_graph_connect(graph, voices[1], drums);
+    ok |= audio_graph_connect(graph, voices[2], bass);
+    ok |= audio_graph_connect(graph, voices[3], lead);
+    ok |= audio_graph_connect(graph, drums, mix);
+    ok |= audio_graph_connect(graph, bass, mix);
+    ok |= audio_graph_connect(graph, lead, mix);
+    ok |= audio_graph_connect(graph, mix, filter);
+    ok |= audio_graph_connect(graph, filter, master);
+    ok |= audio_graph_connect(graph, hihat, master);
+    ok |= audio_graph_connect(graph, master, reverb);
+    ok |= audio_graph_connect(graph, reverb, hall);
+    ok |= audio_graph_connect(graph, hall, limiter);
+    ok |= audio_graph_connect(graph, limiter, live_out);
+    ok |= audio_graph_connect(graph, master, dry_out);
     
-    if (sample > 1.0f) sample = 1.0f;
-    if (sample < -1.0f) sample = -1.0f;
+    // Stems as heard: after ducking, before the shared filter
+    int stem_sources[AUDIO_STEM_COUNT];
+    stem_sources[voice_stems[0]] = voices[0];
+    stem_sources[voice_stems[1]] = voices[1];
+    stem_sources[voice_stems[2]] = bass;
+    stem_sources[voice_stems[3]] = lead;
+    stem_sources[AUDIO_STEM_HIHAT] = hihat;
+    
+    int precalc_sinks[1 + AUDIO_STEM_COUNT];
+    precalc_sinks[0] = dry_out;
+    for (int s = 0; s < AUDIO_STEM_COUNT; s++) {
+        precalc_sinks[1 + s] = audio_graph_add(graph, AUDIO_NODE_OUTPUT, NULL, NULL, AUDIO_OUT_STEMS + s);
+        ok |= audio_graph_connect(graph, stem_sources[s], precalc_sinks[1 + s]);
+    }
+    
+    if (ok != 0 || master < 0) {
+        return -1;
+    }
+    
+    bool parallel = engine->graph.worker_count > 0;
+    if (audio_graph_compile(graph, &engine->live_plan, &live_out, 1, parallel) != 0 ||
+        audio_graph_compile(graph, &engine->precalc_plan, precalc_sinks, 1 + AUDIO_STEM_COUNT, parallel) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Silences the quietest voices beyond the cap. The kick is never stolen since
+// the sidechain keys off it.
+static void audio_cap_voices(AudioEngine* engine) {
+    uint32_t active = 0;
+    for (int i = 0; i < 4; i++) {
+        if (engine->oscillators[i].amplitude > 0.0f) active++;
+    }
+    
+    while (active > engine->voice_cap) {
+        int quietest = -1;
+        for (int i = 1; i < 4; i++) {
+            float amplitude = engine->oscillators[i].amplitude;
+            if (amplitude > 0.0f && (quietest < 0 || amplitude < engine->oscillators[quietest].amplitude)) {
+                quietest = i;
+            }
+        }
+        if (quietest < 0) {
+            break;
+        }
+        engine->oscillators[quietest].amplitude = 0.0f;
+        active--;
+    }
+}
+
+// Renders count samples into the graph outputs. Blocks are cut at row
+// boundaries so every note event lands on the sample it did when the synth
+// ran one sample at a time. energy, if given, accumulates |output| while
+// the kick, bass and lead voices are sounding.
+static void audio_render(AudioEngine* engine, const AudioGraphPlan* plan, uint32_t count, float* energy) {
+    float dt = 1.0f / engine->sequencer.sample_rate;
+    uint32_t done = 0;
     
-    return sample;
+    while (done < count) {
+        audio_update_sequencer(engine, dt);
+        if (engine->voice_cap < 4) {
+            audio_cap_voices(engine);
+        }
+        
+        float row_duration = 60.0f / (engine->sequencer.bpm * 4.0f);
+        float pattern_time = engine->sequencer.pattern_time;
+        uint32_t span = 1;
+        while (span < AUDIO_GRAPH_BLOCK && done + span < count && pattern_time + dt < row_duration) {
+            pattern_time += dt;
+            span++;
+        }
+        
+        bool active[3] = {
+            engine->oscillators[0].amplitude > 0.01f,
+            engine->oscillators[2].amplitude > 0.01f,
+            engine->oscillators[3].amplitude > 0.01f
+        };
+        
+        audio_graph_run(&engine->graph, plan, done, span);
+        audio_sidechain_advance(&engine->sidechain, span);
+        
+        // The rest of the span is known not to reach the next row
+        for (uint32_t i = 1; i < span; i++) {
+            audio_update_sequencer(engine, dt);
+        }
+        
+        if (energy) {
+            const float* out = engine->graph.outputs[AUDIO_OUT_MASTER] + done;
+            float sum = 0.0f;
+            for (uint32_t i = 0; i < span; i++) {
+                sum += fabsf(out[i]);
+            }
+            for (int b = 0; b < 3; b++) {
+                if (active[b]) energy[b] += sum;
+            }
+        }
+        done += span;
+    }
 }
 
 void audio_note_on(Oscillator* osc, float frequency, float amplitude) {
@@ -327,11 +1095,7 @@ float audio_sawtooth(float phase) {
     return (2.0f * wrapped / TWO_PI) - 1.0f;
 }
 
-float audio_noise(void) {
-    return (float)rand() / RAND_MAX * 2.0f - 1.0f;
-}
-
-float audio_filter(AudioEngine* engine, float input, float cutoff, float resonance) {
+static void audio_filter_coefficients(const AudioEngine* engine, float cutoff, float resonance, float* c) {
     float freq = cutoff / engine->sequencer.sample_rate;
     if (freq > 0.49f) freq = 0.49f;
     if (freq < 0.001f) freq = 0.001f;
@@ -339,15 +1103,20 @@ float audio_filter(AudioEngine* engine, float input, float cutoff, float resonan
     float q = resonance;
     
     float d = tanf(PI * freq);
-    float c = 1.0f / (1.0f + d * q + d * d);
+    float norm = 1.0f / (1.0f + d * q + d * d);
     
-    float a0 = d * d * c;
-    float a1 = 2.0f * a0;
-    float a2 = a0;
-    float b1 = 2.0f * (d * d - 1.0f) * c;
-    float b2 = (1.0f - d * q + d * d) * c;
+    c[0] = d * d * norm;
+    c[1] = 2.0f * c[0];
+    c[2] = c[0];
+    c[3] = 2.0f * (d * d - 1.0f) * norm;
+    c[4] = (1.0f - d * q + d * d) * norm;
+}
+
+float audio_filter(AudioEngine* engine, float input, float cutoff, float resonance) {
+    float c[5];
+    audio_filter_coefficients(engine, cutoff, resonance, c);
     
-    float output = a0 * input + a1 * engine->filter_x1 + a2 * engine->filter_x2 - b1 * engine->filter_y1 - b2 * engine->filter_y2;
+    float output = c[0] * input + c[1] * engine->filter_x1 + c[2] * engine->filter_x2 - c[3] * engine->filter_y1 - c[4] * engine->filter_y2;
     
     engine->filter_x2 = engine->filter_x1;
     engine->filter_x1 = input;
@@ -357,13 +1126,40 @@ float audio_filter(AudioEngine* engine, float input, float cutoff, float resonan
     return output;
 }
 
+static AudioResampleQuality audio_resample_quality(void) {
+    const char* quality = getenv("DEMO_AUDIO_RESAMPLE");
+    if (quality && strcmp(quality, "fast") == 0) {
+        return AUDIO_RESAMPLE_FAST;
+    }
+    if (quality && strcmp(quality, "best") == 0) {
+        return AUDIO_RESAMPLE_BEST;
+    }
+    return AUDIO_RESAMPLE_GOOD;
+}
+
 int audio_device_init(AudioEngine* engine) {
     ma_device_config config;
+    uint32_t engine_rate = (uint32_t)engine->sequencer.sample_rate;
+    
+    // Open the device at its native rate when told it, rather than leaving
+    // the conversion to the sound server
+    const char* rate = getenv("DEMO_AUDIO_RATE");
+    engine->device_rate = engine_rate;
+    engine->resampling = false;
+    if (rate && atoi(rate) >= 8000 && atoi(rate) <= 192000 && (uint32_t)atoi(rate) != engine_rate) {
+        if (audio_resampler_init(&engine->resampler, engine_rate, (uint32_t)atoi(rate), audio_resample_quality()) == 0) {
+            engine->device_rate = (uint32_t)atoi(rate);
+            engine->resampling = true;
+            printf("Resampling audio from %u Hz to %u Hz\n", engine_rate, engine->device_rate);
+        } else {
+            fprintf(stderr, "WARNING: Cannot resample to %s Hz, using %u Hz\n", rate, engine_rate);
+        }
+    }
     
     config = ma_device_config_init(ma_device_type_playback);
     config.playback.format   = ma_format_f32;
     config.playback.channels = 2;
-    config.sampleRate        = 44100;
+    config.sampleRate        = engine->device_rate;
     config.dataCallback      = audio_data_callback;
     config.pUserData         = engine;
     
@@ -393,4 +1189,29 @@ void audio_device_cleanup(AudioEngine* engine) {
         ma_device_uninit(&engine->device);
         engine->device_initialized = false;
     }
+}
+
+void audio_release_song(AudioEngine* engine) {
+    free(engine->pcm_storage);
+    free(engine->envelope_storage);
+    file_map_close(&engine->cache_mapping);
+    engine->pcm = NULL;
+    engine->pcm_frames = 0;
+    engine->pcm_storage = NULL;
+    engine->envelope_storage = NULL;
+    engine->envelopes.values = NULL;
+    engine->envelopes.frame_count = 0;
+}
+
+void audio_cleanup(AudioEngine* engine) {
+    audio_release_song(engine);
+    audio_spectrum_free(&engine->spectrum);
+    audio_sidechain_free(&engine->sidechain);
+    audio_reverb_free(&engine->reverb);
+    audio_convolver_free(&engine->convolver);
+    audio_resampler_free(&engine->resampler);
+    engine->resampling = false;
+    audio_graph_stop_workers(&engine->graph);
+    audio_graph_plan_free(&engine->live_plan);
+    audio_graph_plan_free(&engine->precalc_plan);
 }
\ No newline at end of file
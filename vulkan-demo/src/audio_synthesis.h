@@ -5,6 +5,52 @@
 #include <stdbool.h>
 
 #include "miniaudio_minimal.h"
+#include "file_map.h"
+#include "audio_analysis.h"
+#include "audio_limiter.h"
+#include "audio_sidechain.h"
+#include "audio_reverb.h"
+#include "audio_convolver.h"
+#include "audio_graph.h"
+#include "audio_resampler.h"
+#include "audio_oversampler.h"
+#include "audio_clock.h"
+#include "timeline.h"
+
+// Bump whenever the synth code changes what it renders; cached renders keyed
+// on an older version are rebuilt
+#define AUDIO_SYNTH_VERSION 8
+
+#define AUDIO_ENV_HOP 441
+#define AUDIO_BLOCK_SIZE AUDIO_GRAPH_BLOCK
+
+#define AUDIO_LOD_LEVELS 4
+#define AUDIO_LOD_EVENTS 16
+
+typedef enum {
+    AUDIO_STEM_KICK,
+    AUDIO_STEM_SNARE,
+    AUDIO_STEM_BASS,
+    AUDIO_STEM_LEAD,
+    AUDIO_STEM_HIHAT,
+    AUDIO_STEM_COUNT
+} AudioStem;
+
+typedef enum {
+    AUDIO_ENV_RMS,
+    AUDIO_ENV_PEAK,
+    AUDIO_ENV_ONSET,
+    AUDIO_ENV_KIND_COUNT
+} AudioEnvelopeKind;
+
+// Control-rate envelope tracks derived from the per-instrument stems during
+// precalc. Values are laid out [kind][stem][frame] and normalized per track
+// to 0..255, one frame per AUDIO_ENV_HOP samples.
+typedef struct {
+    const uint8_t* values;
+    uint32_t frame_count;
+    float frame_rate;
+} AudioEnvelopeTracks;
 
 typedef struct {
     float frequency;
@@ -25,6 +71,9 @@ typedef struct {
 
 typedef struct {
     Oscillator oscillators[4];
+    float time;
+    // Analysis ring position of the sample heard at time
+    uint32_t ring_pos;
     int current_pattern;
     int current_row;
     float bpm;
@@ -33,15 +82,44 @@ typedef struct {
     float high_energy;
 } AudioSnapshot;
 
+typedef struct {
+    float time;
+    uint32_t from;
+    uint32_t to;
+    float load;
+} AudioLodEvent;
+
+// Callback load is the time spent rendering over the duration of the buffer
+// it filled, smoothed across callbacks. event_count counts every LOD change;
+// events keeps the last AUDIO_LOD_EVENTS of them, indexed modulo its size.
+typedef struct {
+    uint32_t lod;
+    uint32_t callbacks;
+    float load;
+    float peak_load;
+    uint32_t downgrades;
+    uint32_t upgrades;
+    volatile uint32_t event_count;
+    AudioLodEvent events[AUDIO_LOD_EVENTS];
+} AudioStats;
+
 typedef struct {
     Oscillator oscillators[4];
     Sequencer sequencer;
+    // Scene at the sequencer's time, looked up on every row
+    const Timeline* timeline;
+    TimelineCursor timeline_cursor;
+    TimelinePoint scene;
     float master_volume;
     float filter_cutoff;
     float filter_resonance;
     float filter_env;
     ma_device device;
     bool device_initialized;
+    // Devices not running at the engine rate are fed through the resampler
+    uint32_t device_rate;
+    AudioResampler resampler;
+    bool resampling;
     float filter_state;
     float hihat_accumulator;
     float filter_x1;
@@ -49,22 +127,62 @@ typedef struct {
     float filter_y1;
     float filter_y2;
     AudioSnapshot snapshot;
+    AudioLimiter limiter;
+    AudioSidechain sidechain;
+    AudioReverb reverb;
+    AudioConvolver convolver;
+    // Hard-edged oscillators and per-voice drive run at oversample times
+    // the engine rate
+    uint32_t oversample;
+    AudioOversampler voice_oversamplers[4];
+    AudioOversampler drive_oversamplers[4];
+    // Level of detail, stepped down when the callback runs short of
+    // headroom. 0 is full quality.
+    uint32_t lod;
+    bool lod_fixed;
+    uint32_t unison;
+    uint32_t voice_cap;
+    float lod_calm;
+    float lod_settle;
+    AudioStats stats;
+    uint32_t lod_events_reported;
+    AudioGraph graph;
+    AudioGraphPlan live_plan;
+    AudioGraphPlan precalc_plan;
+    const float* pcm;
+    uint32_t pcm_frames;
+    uint32_t play_frame;
+    AudioEnvelopeTracks envelopes;
+    float* pcm_storage;
+    uint8_t* envelope_storage;
+    FileMapping cache_mapping;
+    // Output history for the spectrum analyzer. Written by the audio
+    // callback, read on the main thread; ring_write only ever increases.
+    float analysis_ring[AUDIO_RING_SIZE];
+    volatile uint32_t ring_write;
+    AudioSpectrum spectrum;
+    // Audible song time, published by the callback and smoothed on read
+    AudioClock clock;
 } AudioEngine;
 
 void audio_init(AudioEngine* engine, float sample_rate);
 void audio_update(AudioEngine* engine, float dt);
 void audio_get_snapshot(AudioEngine* engine, AudioSnapshot* snapshot);
-float audio_generate_sample(AudioEngine* engine);
+void audio_get_stats(AudioEngine* engine, AudioStats* stats);
+int audio_precalc(AudioEngine* engine, float seconds);
+uint64_t audio_song_hash(const AudioEngine* engine, float seconds);
+float audio_envelope_value(const AudioEnvelopeTracks* tracks, AudioStem stem, AudioEnvelopeKind kind, float time);
 void audio_note_on(Oscillator* osc, float frequency, float amplitude);
 void audio_note_off(Oscillator* osc);
 void audio_set_filter(AudioEngine* engine, float cutoff, float resonance);
 float audio_sine(float phase);
 float audio_square(float phase);
 float audio_sawtooth(float phase);
-float audio_noise(void);
 float audio_filter(AudioEngine* engine, float input, float cutoff, float resonance);
 int audio_device_init(AudioEngine* engine);
 void audio_device_start(AudioEngine* engine);
 void audio_device_cleanup(AudioEngine* engine);
+void audio_release_song(AudioEngine* engine);
+void audio_cleanup(AudioEngine* engine);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "file_map.h"
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+int file_map_open(FileMapping* mapping, const char* filename) {
+    mapping->data = NULL;
+    mapping->size = 0;
+    
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return -1;
+    }
+    
+    HANDLE view = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!view) {
+        return -1;
+    }
+    
+    // The view keeps the mapping object alive after its handle is closed
+    void* data = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(view);
+    if (!data) {
+        return -1;
+    }
+    
+    mapping->data = data;
+    mapping->size = (size_t)size.QuadPart;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return -1;
+    }
+    
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+    
+    mapping->data = data;
+    mapping->size = (size_t)st.st_size;
+#endif
+    
+    return 0;
+}
+
+void file_map_close(FileMapping* mapping) {
+    if (!mapping->data) {
+        return;
+    }
+    
+#ifdef _WIN32
+    UnmapViewOfFile(mapping->data);
+#else
+    munmap((void*)mapping->data, mapping->size);
+#endif
+    
+    mapping->data = NULL;
+    mapping->size = 0;
+}
+
+int file_replace(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
@@ -0,0 +1,15 @@
+#ifndef FILE_MAP_H
+#define FILE_MAP_H
+
+#include <stddef.h>
+
+typedef struct {
+    const void* data;
+    size_t size;
+} FileMapping;
+
+int file_map_open(FileMapping* mapping, const char* filename);
+void file_map_close(FileMapping* mapping);
+int file_replace(const char* from, const char* to);
+
+#endif
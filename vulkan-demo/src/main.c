@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <math.h>
 #include <time.h>
 
@@ -15,7 +16,17 @@
 #include "vulkan_setup.h"
 #include "shadertoy_compat.h"
 #include "audio_synthesis.h"
+#include "audio_cache.h"
+#include "audio_onset.h"
 #include "sync_system.h"
+#include "sync_export.h"
+#include "sync_record.h"
+
+// Tracks exported with DEMO_SYNC_EXPORT=src/sync_embedded.h, which has to
+// be written under src/ for this include to find it, and built in
+#ifdef SYNC_EMBEDDED
+#include "sync_embedded.h"
+#endif
 
 const char* validationLayers[] = {"VK_LAYER_KHRONOS_validation"};
 const char* deviceExtensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
@@ -58,6 +69,8 @@ int main() {
     DemoApp app = {0};
     AudioEngine audio = {0};
     RocketSync sync = {0};
+    SyncRecorder recorder = {0};
+    OnsetDetector onsets = {0};
     
     printf("Initializing window...\n");
     fflush(stdout);
@@ -71,8 +84,15 @@ int main() {
     fflush(stdout);
     audio_init(&audio, 44100.0f);
     
+    printf("Precalculating soundtrack...\n");
+    fflush(stdout);
+    if (audio_precalc_cached(&audio, AUDIO_CACHE_FILE, audio.timeline->length) != 0) {
+        fprintf(stderr, "WARNING: Audio precalc failed, falling back to realtime synthesis\n");
+    }
+    
     if (audio_device_init(&audio) != 0) {
         fprintf(stderr, "Failed to initialize audio device\n");
+        audio_cleanup(&audio);
         cleanup(&app);
         return 1;
     }
@@ -82,6 +102,39 @@ int main() {
     printf("Initializing sync system...\n");
     fflush(stdout);
     sync_init(&sync);
+
+#ifdef SYNC_EMBEDDED
+    if (sync_export_attach(&sync, sync_embedded, sizeof(sync_embedded)) != 0) {
+        fprintf(stderr, "WARNING: Embedded sync tracks are invalid\n");
+    }
+#else
+    if (sync_export_load(&sync, SYNC_EXPORT_FILE) == 0) {
+        printf("Loaded sync tracks: %s\n", SYNC_EXPORT_FILE);
+    }
+#endif
+    
+    // Replays take the recorded frames in place of live analysis, for
+    // runs that must match exactly
+    const char* record_file = getenv("DEMO_SYNC_RECORD");
+    const char* replay_file = getenv("DEMO_SYNC_REPLAY");
+    if (replay_file && sync_replay_open(&recorder, replay_file, sizeof(ShaderToyUniforms)) == 0) {
+        printf("Replaying sync from %s\n", replay_file);
+        sync.recorder = &recorder;
+    } else if (record_file && sync_record_open(&recorder, record_file, sizeof(ShaderToyUniforms)) == 0) {
+        printf("Recording sync to %s\n", record_file);
+        sync.recorder = &recorder;
+    }
+    
+    const char* editor = getenv("DEMO_ROCKET_HOST");
+    if (editor && sync_editor_connect(&sync, editor, SYNC_EDITOR_PORT) != 0) {
+        fprintf(stderr, "WARNING: No Rocket editor at %s:%d\n", editor, SYNC_EDITOR_PORT);
+    }
+    
+    if (onset_detector_start(&onsets, &audio) == 0) {
+        sync_attach_onsets(&sync, &onsets.queue);
+    } else {
+        fprintf(stderr, "WARNING: Onset detector unavailable, using row-based triggers\n");
+    }
     
     printf("Entering main loop...\n");
     fflush(stdout);
@@ -89,7 +142,23 @@ int main() {
     
     printf("Cleaning up...\n");
     fflush(stdout);
+    onset_detector_stop(&onsets);
+    sync_record_close(&recorder);
+    
+    // Tracks edited this run, as a blob to map or a source file to embed
+    const char* export_file = getenv("DEMO_SYNC_EXPORT");
+    if (export_file) {
+        size_t length = strlen(export_file);
+        int stored = (length > 2 && strcmp(export_file + length - 2, ".h") == 0)
+            ? sync_export_store_source(&sync, export_file, "sync_embedded")
+            : sync_export_store(&sync, export_file);
+        if (stored == 0) {
+            printf("Exported sync tracks: %s\n", export_file);
+        }
+    }
+    sync_cleanup(&sync);
     audio_device_cleanup(&audio);
+    audio_cleanup(&audio);
     cleanup(&app);
     
     printf("Demo finished successfully\n");
@@ -116,7 +185,17 @@ static void mainLoop(DemoApp* app, AudioEngine* audio, RocketSync* sync) {
         lastTime = currentTime;
         
         audio_update(audio, dt);
-        sync_update(sync, audio, dt);
+        if (sync->recorder && sync->recorder->mode == SYNC_RECORD_REPLAY) {
+            if (!sync_replay_begin(sync->recorder, sync, &dt)) {
+                printf("Replay finished at frame %d\n", frame);
+                break;
+            }
+        } else {
+            sync_update(sync, audio, dt);
+            if (sync->recorder) {
+                sync_record_begin(sync->recorder, sync, dt);
+            }
+        }
         drawFrame(app, (float)currentTime, frame, audio, sync);
         
         frame++;
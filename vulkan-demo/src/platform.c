@@ -0,0 +1,318 @@
+#define _POSIX_C_SOURCE 200112L
+// Winsock 2 has to come in before windows.h pulls in the old winsock.h
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+#include "platform.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#endif
+
+#ifdef _WIN32
+static DWORD WINAPI platform_thread_entry(LPVOID param) {
+    PlatformThread* thread = (PlatformThread*)param;
+    thread->func(thread->arg);
+    return 0;
+}
+#else
+static void* platform_thread_entry(void* param) {
+    PlatformThread* thread = (PlatformThread*)param;
+    thread->func(thread->arg);
+    return NULL;
+}
+#endif
+
+int platform_thread_start(PlatformThread* thread, PlatformThreadFunc func, void* arg) {
+    thread->func = func;
+    thread->arg = arg;
+
+#ifdef _WIN32
+    thread->handle = CreateThread(NULL, 0, platform_thread_entry, thread, 0, NULL);
+    return thread->handle ? 0 : -1;
+#else
+    return pthread_create(&thread->handle, NULL, platform_thread_entry, thread) == 0 ? 0 : -1;
+#endif
+}
+
+void platform_thread_join(PlatformThread* thread) {
+#ifdef _WIN32
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
+}
+
+int platform_semaphore_init(PlatformSemaphore* sem) {
+#ifdef _WIN32
+    sem->handle = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+    return sem->handle ? 0 : -1;
+#else
+    return sem_init(&sem->handle, 0, 0) == 0 ? 0 : -1;
+#endif
+}
+
+void platform_semaphore_destroy(PlatformSemaphore* sem) {
+#ifdef _WIN32
+    CloseHandle(sem->handle);
+#else
+    sem_destroy(&sem->handle);
+#endif
+}
+
+void platform_semaphore_post(PlatformSemaphore* sem, uint32_t count) {
+#ifdef _WIN32
+    ReleaseSemaphore(sem->handle, (LONG)count, NULL);
+#else
+    for (uint32_t i = 0; i < count; i++) {
+        sem_post(&sem->handle);
+    }
+#endif
+}
+
+void platform_semaphore_wait(PlatformSemaphore* sem) {
+#ifdef _WIN32
+    WaitForSingleObject(sem->handle, INFINITE);
+#else
+    while (sem_wait(&sem->handle) != 0) {
+    }
+#endif
+}
+
+void platform_sleep_ms(uint32_t ms) {
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+#endif
+}
+
+double platform_time_seconds(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+// Memory from here must be released with platform_aligned_free
+void* platform_aligned_alloc(size_t size, size_t alignment) {
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void* ptr = NULL;
+    if (posix_memalign(&ptr, alignment, size) != 0) {
+        return NULL;
+    }
+    return ptr;
+#endif
+}
+
+void platform_aligned_free(void* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+#ifdef _WIN32
+#define PLATFORM_SOCKET_WOULD_BLOCK (WSAGetLastError() == WSAEWOULDBLOCK)
+#define platform_socket_closesocket closesocket
+#else
+#define PLATFORM_SOCKET_WOULD_BLOCK (errno == EAGAIN || errno == EWOULDBLOCK)
+#define platform_socket_closesocket close
+#endif
+
+// A peer that has gone must fail the send rather than raise SIGPIPE;
+// where the flag is missing, SO_NOSIGPIPE is set on the socket instead
+#ifdef MSG_NOSIGNAL
+#define PLATFORM_SOCKET_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define PLATFORM_SOCKET_SEND_FLAGS 0
+#endif
+
+static void platform_socket_configure(intptr_t handle) {
+    int one = 1;
+    setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+    setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&one, sizeof(one));
+#endif
+}
+
+static int platform_net_init(void) {
+#ifdef _WIN32
+    static bool started = false;
+    WSADATA data;
+    if (!started) {
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+            return -1;
+        }
+        started = true;
+    }
+#endif
+    return 0;
+}
+
+// Blocking connect; sockets start out blocking with Nagle disabled, since
+// the sync protocol is all small messages
+int platform_socket_connect(PlatformSocket* sock, const char* host, uint16_t port) {
+    struct addrinfo hints;
+    struct addrinfo* addresses = NULL;
+    char service[8];
+    
+    sock->handle = -1;
+    if (platform_net_init() != 0) {
+        return -1;
+    }
+    
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(service, sizeof(service), "%u", port);
+    if (getaddrinfo(host, service, &hints, &addresses) != 0) {
+        return -1;
+    }
+    
+    for (struct addrinfo* a = addresses; a; a = a->ai_next) {
+        intptr_t handle = (intptr_t)socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (handle == -1) {
+            continue;
+        }
+        if (connect(handle, a->ai_addr, (int)a->ai_addrlen) == 0) {
+            platform_socket_configure(handle);
+            sock->handle = handle;
+            break;
+        }
+        platform_socket_closesocket(handle);
+    }
+    freeaddrinfo(addresses);
+    return (sock->handle != -1) ? 0 : -1;
+}
+
+// Listens on the loopback interface only
+int platform_socket_listen(PlatformSocket* sock, uint16_t port) {
+    struct sockaddr_in address;
+    int one = 1;
+    
+    sock->handle = -1;
+    if (platform_net_init() != 0) {
+        return -1;
+    }
+    
+    intptr_t handle = (intptr_t)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (handle == -1) {
+        return -1;
+    }
+    setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one));
+    
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (bind(handle, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(handle, 1) != 0) {
+        platform_socket_closesocket(handle);
+        return -1;
+    }
+    sock->handle = handle;
+    return 0;
+}
+
+int platform_socket_accept(PlatformSocket* server, PlatformSocket* client) {
+    client->handle = (intptr_t)accept(server->handle, NULL, NULL);
+    if (client->handle == -1) {
+        return -1;
+    }
+    platform_socket_configure(client->handle);
+    return 0;
+}
+
+int platform_socket_set_blocking(PlatformSocket* sock, bool blocking) {
+#ifdef _WIN32
+    u_long mode = blocking ? 0 : 1;
+    return ioctlsocket(sock->handle, FIONBIO, &mode) == 0 ? 0 : -1;
+#else
+    int flags = fcntl((int)sock->handle, F_GETFL, 0);
+    if (flags < 0) {
+        return -1;
+    }
+    flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+    return fcntl((int)sock->handle, F_SETFL, flags) == 0 ? 0 : -1;
+#endif
+}
+
+// Sends all of data. Non-blocking sockets wait for buffer space for up to
+// timeout seconds in all, then fail as if the peer had gone.
+int platform_socket_send(PlatformSocket* sock, const void* data, uint32_t size, double timeout) {
+    const char* bytes = (const char*)data;
+    double deadline = platform_time_seconds() + timeout;
+    
+    while (size > 0) {
+        int sent = (int)send(sock->handle, bytes, (int)size, PLATFORM_SOCKET_SEND_FLAGS);
+        if (sent > 0) {
+            bytes += sent;
+            size -= (uint32_t)sent;
+        } else if (sent < 0 && PLATFORM_SOCKET_WOULD_BLOCK) {
+            double remaining = deadline - platform_time_seconds();
+            if (remaining <= 0.0) {
+                return -1;
+            }
+            struct timeval wait;
+            wait.tv_sec = (long)remaining;
+            wait.tv_usec = (long)((remaining - (double)wait.tv_sec) * 1e6);
+            fd_set writable;
+            FD_ZERO(&writable);
+            FD_SET(sock->handle, &writable);
+            select((int)sock->handle + 1, NULL, &writable, NULL, &wait);
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Returns the number of bytes read, 0 when a non-blocking socket has
+// nothing pending, and -1 once the peer has gone
+int platform_socket_recv(PlatformSocket* sock, void* data, uint32_t size) {
+    int received = (int)recv(sock->handle, (char*)data, (int)size, 0);
+    if (received > 0) {
+        return received;
+    }
+    if (received < 0 && PLATFORM_SOCKET_WOULD_BLOCK) {
+        return 0;
+    }
+    return -1;
+}
+
+void platform_socket_close(PlatformSocket* sock) {
+    if (sock->handle != -1) {
+        platform_socket_closesocket(sock->handle);
+        sock->handle = -1;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#endif
+
+// Word-sized atomics shared between the audio callback and the main thread.
+// GCC, Clang and MinGW all provide the __atomic builtins.
+static inline uint32_t atomic_load_u32(const volatile uint32_t* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void atomic_store_u32(volatile uint32_t* p, uint32_t v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+// Returns the value before the add
+static inline uint32_t atomic_fetch_add_u32(volatile uint32_t* p, uint32_t v) {
+    return __atomic_fetch_add(p, v, __ATOMIC_ACQ_REL);
+}
+
+typedef void (*PlatformThreadFunc)(void* arg);
+
+typedef struct {
+    PlatformThreadFunc func;
+    void* arg;
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+} PlatformThread;
+
+typedef struct {
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    sem_t handle;
+#endif
+} PlatformSemaphore;
+
+// TCP socket. The handle holds a SOCKET on Windows and a descriptor
+// elsewhere; -1 when closed.
+typedef struct {
+    intptr_t handle;
+} PlatformSocket;
+
+int platform_thread_start(PlatformThread* thread, PlatformThreadFunc func, void* arg);
+void platform_thread_join(PlatformThread* thread);
+int platform_semaphore_init(PlatformSemaphore* sem);
+void platform_semaphore_destroy(PlatformSemaphore* sem);
+void platform_semaphore_post(PlatformSemaphore* sem, uint32_t count);
+void platform_semaphore_wait(PlatformSemaphore* sem);
+void platform_sleep_ms(uint32_t ms);
+double platform_time_seconds(void);
+void* platform_aligned_alloc(size_t size, size_t alignment);
+void platform_aligned_free(void* ptr);
+int platform_socket_connect(PlatformSocket* sock, const char* host, uint16_t port);
+int platform_socket_listen(PlatformSocket* sock, uint16_t port);
+int platform_socket_accept(PlatformSocket* server, PlatformSocket* client);
+int platform_socket_set_blocking(PlatformSocket* sock, bool blocking);
+int platform_socket_send(PlatformSocket* sock, const void* data, uint32_t size, double timeout);
+int platform_socket_recv(PlatformSocket* sock, void* data, uint32_t size);
+void platform_socket_close(PlatformSocket* sock);
+
+#endif
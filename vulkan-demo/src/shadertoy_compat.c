@@ -1,24 +1,9 @@
 #include "shadertoy_compat.h"
+#include "sync_record.h"
+#include "platform.h"
 #include <string.h>
 #include <stdio.h>
 
-typedef struct {
-    float iTime;
-    float _padding1;
-    float iResolution[2];
-    float iMouse[4];
-    int iFrame;
-    int iScene;
-    float iTransition;
-    float iBass;
-    float iMid;
-    float iHigh;
-    float iIntensity;
-    int iKick;
-    int iSnare;
-    float _padding2;
-} ShaderToyUniforms;
-
 void updateUniforms(DemoApp* app, float currentTime, int frame, AudioEngine* audio, RocketSync* sync) {
     if (!app || !app->window || !sync) {
         fprintf(stderr, "ERROR: NULL pointer in updateUniforms (app=%p, window=%p, sync=%p)\n", 
@@ -38,29 +23,56 @@ void updateUniforms(DemoApp* app, float currentTime, int frame, AudioEngine* aud
     uniforms.iMouse[2] = 0.0f;
     uniforms.iMouse[3] = 0.0f;
     
-    int sceneId = (int)(currentTime / 12.0) % 5;
-    uniforms.iScene = sceneId;
-    
-    float sceneTime = currentTime - (sceneId * 12.0f);
-    uniforms.iTransition = sceneTime < 1.0f ? sceneTime : (sceneTime > 11.0f ? (12.0f - sceneTime) : 1.0f);
+    uniforms.iScene = sync->scene.scene;
+    uniforms.iTransition = sync->scene.transition;
     
-    uniforms.iBass = sync->current.bass;
-    uniforms.iMid = sync->current.mid;
-    uniforms.iHigh = sync->current.high;
-    uniforms.iIntensity = sync->current.intensity;
+    // Track values as of the last update; the named fields are the
+    // built-in ones. Unregistered slots stay 0.
+    uint32_t tracks = (sync->tracks.count < SYNC_UNIFORM_TRACKS) ? sync->tracks.count : SYNC_UNIFORM_TRACKS;
+    memcpy(uniforms.iTracks, sync->tracks.values, tracks * sizeof(float));
+    uniforms.iBass = uniforms.iTracks[SYNC_TRACK_BASS];
+    uniforms.iMid = uniforms.iTracks[SYNC_TRACK_MID];
+    uniforms.iHigh = uniforms.iTracks[SYNC_TRACK_HIGH];
+    uniforms.iIntensity = uniforms.iTracks[SYNC_TRACK_INTENSITY];
     uniforms.iKick = sync->current.kick ? 1 : 0;
     uniforms.iSnare = sync->current.snare ? 1 : 0;
+    uniforms.iTriggers = (uint32_t)sync->fired;
+    uniforms.iBeat = sync->current.beat;
+    
+    if (sync->recorder) {
+        sync_record_uniforms(sync->recorder, &uniforms, sizeof(uniforms));
+    }
+    
+    // This frame's slot; its fence has signalled, so the GPU is done with it.
+    // With push constants only the track values go through the buffer.
+    uint8_t* slot = (uint8_t*)app->uniformBufferMapped + app->currentFrame * app->uniformStride;
+    if (app->pushConstants) {
+        uint32_t header = app->pushConstantSize;
+        memcpy(app->pushConstantData, &uniforms, header);
+        memcpy(slot + header, (const uint8_t*)&uniforms + header, sizeof(uniforms) - header);
+    } else {
+        memcpy(slot, &uniforms, sizeof(uniforms));
+    }
+}
+
+void updateAudioTexture(DemoApp* app, AudioEngine* audio) {
+    if (!audio || !app->audioStagingMapped) {
+        return;
+    }
+    
+    AudioSpectrum* spectrum = &audio->spectrum;
+    audio_spectrum_update(spectrum, audio->analysis_ring, atomic_load_u32(&audio->ring_write));
     
-    void* data;
-    vkMapMemory(app->device, app->uniformBufferMemory, 0, sizeof(uniforms), 0, &data);
-    memcpy(data, &uniforms, sizeof(uniforms));
-    vkUnmapMemory(app->device, app->uniformBufferMemory);
+    // The staging slot for this frame is free once its fence has signalled;
+    // the matching upload command buffer copies it into the texture
+    uint8_t* slot = (uint8_t*)app->audioStagingMapped + app->currentFrame * AUDIO_TEXTURE_SIZE;
+    memcpy(slot, spectrum->texture, AUDIO_TEXTURE_SIZE);
 }
 
 VkDescriptorSetLayoutBinding createUniformBinding() {
     VkDescriptorSetLayoutBinding uboLayoutBinding = {0};
     uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
     uboLayoutBinding.pImmutableSamplers = NULL;
@@ -79,7 +91,7 @@ VkWriteDescriptorSet createUniformWrite(VkDescriptorSet descriptorSet, VkBuffer
     descriptorWrite.dstSet = descriptorSet;
     descriptorWrite.dstBinding = 0;
     descriptorWrite.dstArrayElement = 0;
-    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     descriptorWrite.descriptorCount = 1;
     descriptorWrite.pBufferInfo = &bufferInfo;
     
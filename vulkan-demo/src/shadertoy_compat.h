@@ -6,7 +6,32 @@
 #include "sync_system.h"
 #include <vulkan/vulkan.h>
 
+// Matches the std140 uniform block in shader.frag
+typedef struct {
+    float iTime;
+    float _padding1;
+    float iResolution[2];
+    float iMouse[4];
+    int iFrame;
+    int iScene;
+    float iTransition;
+    float iBass;
+    float iMid;
+    float iHigh;
+    float iIntensity;
+    int iKick;
+    int iSnare;
+    // Triggers that fired this frame, one bit per SyncTriggerKind
+    uint32_t iTriggers;
+    // Song position in beats, locked to the audio clock
+    float iBeat;
+    float _padding3;
+    // Sync track values by handle
+    float iTracks[SYNC_UNIFORM_TRACKS];
+} ShaderToyUniforms;
+
 void updateUniforms(DemoApp* app, float currentTime, int frame, AudioEngine* audio, RocketSync* sync);
+void updateAudioTexture(DemoApp* app, AudioEngine* audio);
 VkDescriptorSetLayoutBinding createUniformBinding();
 VkWriteDescriptorSet createUniformWrite(VkDescriptorSet descriptorSet, VkBuffer uniformBuffer);
 
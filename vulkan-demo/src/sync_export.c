@@ -0,0 +1,224 @@
+#include "sync_export.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYNC_EXPORT_MAGIC 0x434e5953u
+#define SYNC_EXPORT_VERSION 1
+
+// The blob is this header, the track table, then the keys of every track
+// back to back as one rows array, one values array and one types array,
+// each starting on a SYNC_EXPORT_ALIGN boundary. A track's keys are the
+// slice [first_key, first_key + key_count) of all three, so loading only
+// points the tracks into the blob.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t rows_per_beat;
+    uint32_t track_count;
+    uint32_t key_count;
+    uint32_t rows_offset;
+    uint32_t values_offset;
+    uint32_t types_offset;
+    uint8_t reserved[28];
+} SyncExportHeader;
+
+typedef struct {
+    char name[SYNC_TRACK_NAME];
+    uint32_t first_key;
+    uint32_t key_count;
+} SyncExportTrack;
+
+static uint32_t sync_export_align(uint32_t offset) {
+    return (offset + SYNC_EXPORT_ALIGN - 1) & ~(uint32_t)(SYNC_EXPORT_ALIGN - 1);
+}
+
+// Lays out the blob for sync's keyframe tracks into a zeroed allocation
+static uint8_t* sync_export_build(const RocketSync* sync, uint32_t* size) {
+    const SyncTracks* tracks = &sync->tracks;
+    uint32_t track_count = 0;
+    uint32_t key_count = 0;
+    
+    for (uint32_t h = 0; h < tracks->count; h++) {
+        if (tracks->keys[h].count > 0) {
+            track_count++;
+            key_count += tracks->keys[h].count;
+        }
+    }
+    
+    SyncExportHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SYNC_EXPORT_MAGIC;
+    header.version = SYNC_EXPORT_VERSION;
+    header.rows_per_beat = SYNC_ROWS_PER_BEAT;
+    header.track_count = track_count;
+    header.key_count = key_count;
+    header.rows_offset = sync_export_align(sizeof(header) + track_count * sizeof(SyncExportTrack));
+    header.values_offset = sync_export_align(header.rows_offset + key_count * sizeof(uint32_t));
+    header.types_offset = sync_export_align(header.values_offset + key_count * sizeof(float));
+    header.size = sync_export_align(header.types_offset + key_count * sizeof(uint8_t));
+    
+    uint8_t* blob = calloc(1, header.size);
+    if (!blob) {
+        fprintf(stderr, "Failed to allocate %u bytes for sync export\n", header.size);
+        return NULL;
+    }
+    memcpy(blob, &header, sizeof(header));
+    
+    SyncExportTrack* table = (SyncExportTrack*)(blob + sizeof(header));
+    uint32_t first = 0;
+    for (uint32_t h = 0; h < tracks->count; h++) {
+        const SyncKeyTrack* keys = &tracks->keys[h];
+        if (keys->count == 0) {
+            continue;
+        }
+        memcpy(table->name, tracks->names[h], SYNC_TRACK_NAME);
+        table->first_key = first;
+        table->key_count = keys->count;
+        memcpy(blob + header.rows_offset + first * sizeof(uint32_t), keys->rows, keys->count * sizeof(uint32_t));
+        memcpy(blob + header.values_offset + first * sizeof(float), keys->values, keys->count * sizeof(float));
+        memcpy(blob + header.types_offset + first * sizeof(uint8_t), keys->types, keys->count * sizeof(uint8_t));
+        first += keys->count;
+        table++;
+    }
+    
+    *size = header.size;
+    return blob;
+}
+
+// Gives the tracks borrowing from the mapped export keys of their own and
+// unmaps it, since Windows will not replace a file with a view open
+static int sync_export_unmap(RocketSync* sync) {
+    if (!sync->export_mapping.data) {
+        return 0;
+    }
+    for (uint32_t h = 0; h < sync->tracks.count; h++) {
+        SyncKeyTrack* keys = &sync->tracks.keys[h];
+        if (keys->capacity == 0 && keys->rows && sync_key_track_own(keys) != 0) {
+            return -1;
+        }
+    }
+    file_map_close(&sync->export_mapping);
+    return 0;
+}
+
+int sync_export_store(RocketSync* sync, const char* filename) {
+    uint32_t size;
+    uint8_t* blob = sync_export_build(sync, &size);
+    if (!blob) {
+        return -1;
+    }
+    
+    char temp_name[512];
+    snprintf(temp_name, sizeof(temp_name), "%s.tmp", filename);
+    
+    FILE* file = fopen(temp_name, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to write sync export: %s\n", temp_name);
+        free(blob);
+        return -1;
+    }
+    
+    bool ok = fwrite(blob, 1, size, file) == size;
+    ok = (fclose(file) == 0) && ok;
+    free(blob);
+    
+    // The file being replaced may be the one the tracks were loaded from
+    if (!ok || sync_export_unmap(sync) != 0 || file_replace(temp_name, filename) != 0) {
+        fprintf(stderr, "Failed to write sync export: %s\n", filename);
+        remove(temp_name);
+        return -1;
+    }
+    return 0;
+}
+
+// Writes the blob as a C array of 32-bit words, to be compiled into the
+// player and handed to sync_export_attach()
+int sync_export_store_source(const RocketSync* sync, const char* filename, const char* symbol) {
+    uint32_t size;
+    uint8_t* blob = sync_export_build(sync, &size);
+    if (!blob) {
+        return -1;
+    }
+    
+    FILE* file = fopen(filename, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to write sync export: %s\n", filename);
+        free(blob);
+        return -1;
+    }
+    
+    fprintf(file, "// Generated by sync_export_store_source(), do not edit\n");
+    fprintf(file, "#include <stdint.h>\n\n");
+    fprintf(file, "#if defined(_MSC_VER)\n__declspec(align(%d))\n#endif\n", SYNC_EXPORT_ALIGN);
+    fprintf(file, "static const uint32_t %s[%u]\n", symbol, size / 4);
+    fprintf(file, "#if defined(__GNUC__)\n__attribute__((aligned(%d)))\n#endif\n= {", SYNC_EXPORT_ALIGN);
+    for (uint32_t i = 0; i < size / 4; i++) {
+        uint32_t word;
+        memcpy(&word, blob + i * 4, 4);
+        fprintf(file, "%s0x%08xu,", (i % 8 == 0) ? "\n    " : " ", word);
+    }
+    fprintf(file, "\n};\n");
+    free(blob);
+    
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Failed to write sync export: %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+// Points sync's tracks at the keys inside data, which must stay valid until
+// sync_cleanup(). Nothing is copied or allocated beyond track registration.
+int sync_export_attach(RocketSync* sync, const void* data, size_t size) {
+    const SyncExportHeader* header = data;
+    const uint8_t* blob = data;
+    
+    if (((uintptr_t)data & (SYNC_EXPORT_ALIGN - 1)) != 0 || size < sizeof(SyncExportHeader) ||
+        header->magic != SYNC_EXPORT_MAGIC || header->version != SYNC_EXPORT_VERSION ||
+        header->rows_per_beat != SYNC_ROWS_PER_BEAT || header->size != size ||
+        sizeof(SyncExportHeader) + (size_t)header->track_count * sizeof(SyncExportTrack) > header->rows_offset ||
+        header->rows_offset + (size_t)header->key_count * sizeof(uint32_t) > header->values_offset ||
+        header->values_offset + (size_t)header->key_count * sizeof(float) > header->types_offset ||
+        header->types_offset + (size_t)header->key_count > size) {
+        return -1;
+    }
+    
+    const SyncExportTrack* table = (const SyncExportTrack*)(header + 1);
+    const uint32_t* rows = (const uint32_t*)(blob + header->rows_offset);
+    const float* values = (const float*)(blob + header->values_offset);
+    const uint8_t* types = blob + header->types_offset;
+    
+    for (uint32_t i = 0; i < header->track_count; i++) {
+        if (table[i].first_key > header->key_count || table[i].key_count > header->key_count - table[i].first_key) {
+            return -1;
+        }
+    }
+    
+    for (uint32_t i = 0; i < header->track_count; i++) {
+        char name[SYNC_TRACK_NAME];
+        uint32_t first = table[i].first_key;
+        memcpy(name, table[i].name, SYNC_TRACK_NAME);
+        name[SYNC_TRACK_NAME - 1] = '\0';
+        sync_borrow_keys(sync, sync_track(sync, name), rows + first, values + first, types + first, table[i].key_count);
+    }
+    return 0;
+}
+
+// One export per sync; its tracks borrow from the mapping until cleanup
+int sync_export_load(RocketSync* sync, const char* filename) {
+    FileMapping mapping;
+    if (sync->export_mapping.data || file_map_open(&mapping, filename) != 0) {
+        return -1;
+    }
+    
+    if (sync_export_attach(sync, mapping.data, mapping.size) != 0) {
+        fprintf(stderr, "Sync export %s is invalid, ignoring it\n", filename);
+        file_map_close(&mapping);
+        return -1;
+    }
+    
+    sync->export_mapping = mapping;
+    return 0;
+}
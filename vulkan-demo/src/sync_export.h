@@ -0,0 +1,15 @@
+#ifndef SYNC_EXPORT_H
+#define SYNC_EXPORT_H
+
+#include "sync_system.h"
+
+#define SYNC_EXPORT_FILE "sync.bin"
+// Blobs must start at least this aligned, mapped or embedded
+#define SYNC_EXPORT_ALIGN 16
+
+int sync_export_store(RocketSync* sync, const char* filename);
+int sync_export_store_source(const RocketSync* sync, const char* filename, const char* symbol);
+int sync_export_attach(RocketSync* sync, const void* data, size_t size);
+int sync_export_load(RocketSync* sync, const char* filename);
+
+#endif
@@ -0,0 +1,453 @@
+#include "sync_expr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#define SYNC_EXPR_NAME 32
+
+// While parsing, operands are tagged by kind and renumbered into the final
+// register layout once the track and constant counts are known
+#define SYNC_REG_TRACK 0x20
+#define SYNC_REG_CONSTANT 0x40
+#define SYNC_REG_TEMP 0x80
+
+typedef enum {
+    SYNC_OP_ADD,
+    SYNC_OP_SUB,
+    SYNC_OP_MUL,
+    SYNC_OP_DIV,
+    SYNC_OP_MOD,
+    SYNC_OP_MIN,
+    SYNC_OP_MAX,
+    SYNC_OP_POW,
+    SYNC_OP_STEP,
+    SYNC_OP_NEG,
+    SYNC_OP_SIN,
+    SYNC_OP_COS,
+    SYNC_OP_ABS,
+    SYNC_OP_FLOOR,
+    SYNC_OP_FRACT,
+    SYNC_OP_SQRT
+} SyncExprOpcode;
+
+static const char* sync_expr_input_names[SYNC_EXPR_INPUTS] = {
+    "time", "beat", "row", "bass", "mid", "high", "intensity"
+};
+
+static const struct {
+    const char* name;
+    uint8_t op;
+    uint8_t args;
+} sync_expr_functions[] = {
+    {"sin", SYNC_OP_SIN, 1},
+    {"cos", SYNC_OP_COS, 1},
+    {"abs", SYNC_OP_ABS, 1},
+    {"floor", SYNC_OP_FLOOR, 1},
+    {"fract", SYNC_OP_FRACT, 1},
+    {"sqrt", SYNC_OP_SQRT, 1},
+    {"min", SYNC_OP_MIN, 2},
+    {"max", SYNC_OP_MAX, 2},
+    {"pow", SYNC_OP_POW, 2},
+    {"step", SYNC_OP_STEP, 2}
+};
+
+typedef struct {
+    SyncExpr* expr;
+    const char* source;
+    const char* p;
+    SyncExprResolve resolve;
+    void* user;
+    uint32_t temps;
+    uint32_t max_temps;
+    const char* error;
+} SyncExprParser;
+
+static int sync_expr_parse_sum(SyncExprParser* parser);
+
+static int sync_expr_fail(SyncExprParser* parser, const char* error) {
+    if (!parser->error) {
+        parser->error = error;
+    }
+    return -1;
+}
+
+static void sync_expr_skip(SyncExprParser* parser) {
+    while (isspace((unsigned char)*parser->p)) {
+        parser->p++;
+    }
+}
+
+static bool sync_expr_accept(SyncExprParser* parser, char c) {
+    sync_expr_skip(parser);
+    if (*parser->p == c) {
+        parser->p++;
+        return true;
+    }
+    return false;
+}
+
+static int sync_expr_constant(SyncExprParser* parser, float value) {
+    SyncExpr* expr = parser->expr;
+    for (uint32_t k = 0; k < expr->constant_count; k++) {
+        if (expr->constants[k] == value) {
+            return SYNC_REG_CONSTANT | k;
+        }
+    }
+    if (expr->constant_count == SYNC_EXPR_MAX_CONSTANTS) {
+        return sync_expr_fail(parser, "too many constants");
+    }
+    expr->constants[expr->constant_count] = value;
+    return SYNC_REG_CONSTANT | expr->constant_count++;
+}
+
+static int sync_expr_track(SyncExprParser* parser, int handle) {
+    SyncExpr* expr = parser->expr;
+    for (uint32_t j = 0; j < expr->track_count; j++) {
+        if (expr->tracks[j] == handle) {
+            return SYNC_REG_TRACK | j;
+        }
+    }
+    if (expr->track_count == SYNC_EXPR_MAX_TRACKS) {
+        return sync_expr_fail(parser, "too many tracks");
+    }
+    expr->tracks[expr->track_count] = (int16_t)handle;
+    return SYNC_REG_TRACK | expr->track_count++;
+}
+
+static void sync_expr_release(SyncExprParser* parser, int reg) {
+    if (reg >= 0 && (reg & SYNC_REG_TEMP)) {
+        parser->temps &= ~(1u << (reg & ~SYNC_REG_TEMP));
+    }
+}
+
+// Releases the operands before allocating the result, so the result may
+// reuse an operand's register. keep_b leaves b live for a later use.
+static int sync_expr_emit_op(SyncExprParser* parser, uint8_t op, int a, int b, bool keep_b) {
+    SyncExpr* expr = parser->expr;
+    if (a < 0 || b < 0) {
+        return -1;
+    }
+    if (expr->code_count == SYNC_EXPR_MAX_CODE) {
+        return sync_expr_fail(parser, "expression too long");
+    }
+    
+    sync_expr_release(parser, a);
+    if (!keep_b) sync_expr_release(parser, b);
+    uint32_t temp = 0;
+    while (parser->temps & (1u << temp)) {
+        temp++;
+    }
+    parser->temps |= 1u << temp;
+    if (temp + 1 > parser->max_temps) {
+        parser->max_temps = temp + 1;
+    }
+    
+    SyncExprOp* code = &expr->code[expr->code_count++];
+    code->op = op;
+    code->dst = (uint8_t)(SYNC_REG_TEMP | temp);
+    code->a = (uint8_t)a;
+    code->b = (uint8_t)b;
+    return code->dst;
+}
+
+static int sync_expr_emit(SyncExprParser* parser, uint8_t op, int a, int b) {
+    return sync_expr_emit_op(parser, op, a, b, false);
+}
+
+static int sync_expr_parse_call(SyncExprParser* parser, const char* name) {
+    int args[3];
+    uint32_t count = 0;
+    
+    if (!sync_expr_accept(parser, ')')) {
+        do {
+            if (count == 3) {
+                return sync_expr_fail(parser, "too many arguments");
+            }
+            args[count++] = sync_expr_parse_sum(parser);
+        } while (sync_expr_accept(parser, ','));
+        if (!sync_expr_accept(parser, ')')) {
+            return sync_expr_fail(parser, "expected ')'");
+        }
+    }
+    
+    // clamp and mix expand into the basic operations
+    if (strcmp(name, "clamp") == 0 && count == 3) {
+        return sync_expr_emit(parser, SYNC_OP_MIN, sync_expr_emit(parser, SYNC_OP_MAX, args[0], args[1]), args[2]);
+    }
+    if (strcmp(name, "mix") == 0 && count == 3) {
+        int a = args[0];
+        int span = sync_expr_emit_op(parser, SYNC_OP_SUB, args[1], a, true);
+        return sync_expr_emit(parser, SYNC_OP_ADD, a, sync_expr_emit(parser, SYNC_OP_MUL, span, args[2]));
+    }
+    for (size_t i = 0; i < sizeof(sync_expr_functions) / sizeof(sync_expr_functions[0]); i++) {
+        if (strcmp(name, sync_expr_functions[i].name) == 0) {
+            if (count != sync_expr_functions[i].args) {
+                return sync_expr_fail(parser, "wrong number of arguments");
+            }
+            return sync_expr_emit(parser, sync_expr_functions[i].op, args[0], (count == 2) ? args[1] : args[0]);
+        }
+    }
+    return sync_expr_fail(parser, "unknown function");
+}
+
+static int sync_expr_parse_primary(SyncExprParser* parser) {
+    sync_expr_skip(parser);
+    const char* p = parser->p;
+    
+    if (*p == '(') {
+        parser->p++;
+        int reg = sync_expr_parse_sum(parser);
+        if (!sync_expr_accept(parser, ')')) {
+            return sync_expr_fail(parser, "expected ')'");
+        }
+        return reg;
+    }
+    
+    if (isdigit((unsigned char)*p) || *p == '.') {
+        char* end;
+        float value = strtof(p, &end);
+        if (end == p) {
+            return sync_expr_fail(parser, "bad number");
+        }
+        parser->p = end;
+        return sync_expr_constant(parser, value);
+    }
+    
+    if (isalpha((unsigned char)*p) || *p == '_') {
+        char name[SYNC_EXPR_NAME];
+        size_t length = 0;
+        while (isalnum((unsigned char)*p) || *p == '_' || *p == '.') {
+            if (length == SYNC_EXPR_NAME - 1) {
+                return sync_expr_fail(parser, "name too long");
+            }
+            name[length++] = *p++;
+        }
+        name[length] = '\0';
+        parser->p = p;
+        
+        if (sync_expr_accept(parser, '(')) {
+            return sync_expr_parse_call(parser, name);
+        }
+        if (strcmp(name, "pi") == 0) {
+            return sync_expr_constant(parser, 3.14159265f);
+        }
+        for (int i = 0; i < SYNC_EXPR_INPUTS; i++) {
+            if (strcmp(name, sync_expr_input_names[i]) == 0) {
+                return i;
+            }
+        }
+        int handle = parser->resolve ? parser->resolve(parser->user, name) : -1;
+        if (handle < 0) {
+            return sync_expr_fail(parser, "unknown name");
+        }
+        return sync_expr_track(parser, handle);
+    }
+    
+    return sync_expr_fail(parser, "expected a value");
+}
+
+static int sync_expr_parse_unary(SyncExprParser* parser);
+
+static int sync_expr_parse_power(SyncExprParser* parser) {
+    int base = sync_expr_parse_primary(parser);
+    if (sync_expr_accept(parser, '^')) {
+        return sync_expr_emit(parser, SYNC_OP_POW, base, sync_expr_parse_unary(parser));
+    }
+    return base;
+}
+
+static int sync_expr_parse_unary(SyncExprParser* parser) {
+    if (sync_expr_accept(parser, '-')) {
+        sync_expr_skip(parser);
+        // Fold negative literals into constants
+        if (isdigit((unsigned char)*parser->p) || *parser->p == '.') {
+            char* end;
+            float value = strtof(parser->p, &end);
+            // -2^2 is -(2^2), with or without spaces around the ^
+            const char* next = end;
+            while (isspace((unsigned char)*next)) {
+                next++;
+            }
+            if (end != parser->p && *next != '^') {
+                parser->p = end;
+                return sync_expr_constant(parser, -value);
+            }
+        }
+        int a = sync_expr_parse_unary(parser);
+        return sync_expr_emit(parser, SYNC_OP_NEG, a, a);
+    }
+    return sync_expr_parse_power(parser);
+}
+
+static int sync_expr_parse_product(SyncExprParser* parser) {
+    int a = sync_expr_parse_unary(parser);
+    for (;;) {
+        if (sync_expr_accept(parser, '*')) {
+            a = sync_expr_emit(parser, SYNC_OP_MUL, a, sync_expr_parse_unary(parser));
+        } else if (sync_expr_accept(parser, '/')) {
+            a = sync_expr_emit(parser, SYNC_OP_DIV, a, sync_expr_parse_unary(parser));
+        } else if (sync_expr_accept(parser, '%')) {
+            a = sync_expr_emit(parser, SYNC_OP_MOD, a, sync_expr_parse_unary(parser));
+        } else {
+            return a;
+        }
+    }
+}
+
+static int sync_expr_parse_sum(SyncExprParser* parser) {
+    int a = sync_expr_parse_product(parser);
+    for (;;) {
+        if (sync_expr_accept(parser, '+')) {
+            a = sync_expr_emit(parser, SYNC_OP_ADD, a, sync_expr_parse_product(parser));
+        } else if (sync_expr_accept(parser, '-')) {
+            a = sync_expr_emit(parser, SYNC_OP_SUB, a, sync_expr_parse_product(parser));
+        } else {
+            return a;
+        }
+    }
+}
+
+static uint8_t sync_expr_register(const SyncExpr* expr, int reg) {
+    if (reg & SYNC_REG_TEMP) {
+        return (uint8_t)(SYNC_EXPR_INPUTS + expr->track_count + expr->constant_count + (reg & ~SYNC_REG_TEMP));
+    }
+    if (reg & SYNC_REG_CONSTANT) {
+        return (uint8_t)(SYNC_EXPR_INPUTS + expr->track_count + (reg & ~SYNC_REG_CONSTANT));
+    }
+    if (reg & SYNC_REG_TRACK) {
+        return (uint8_t)(SYNC_EXPR_INPUTS + (reg & ~SYNC_REG_TRACK));
+    }
+    return (uint8_t)reg;
+}
+
+// Compiles source into expr. Names other than the inputs, pi and the
+// functions are handed to resolve as track names.
+int sync_expr_compile(SyncExpr* expr, const char* source, SyncExprResolve resolve, void* user) {
+    SyncExprParser parser;
+    
+    memset(expr, 0, sizeof(*expr));
+    memset(&parser, 0, sizeof(parser));
+    parser.expr = expr;
+    parser.source = source;
+    parser.p = source;
+    parser.resolve = resolve;
+    parser.user = user;
+    
+    int result = sync_expr_parse_sum(&parser);
+    sync_expr_skip(&parser);
+    if (result >= 0 && *parser.p != '\0') {
+        sync_expr_fail(&parser, "unexpected character");
+    }
+    if (!parser.error && SYNC_EXPR_INPUTS + expr->track_count + expr->constant_count + parser.max_temps > SYNC_EXPR_REGISTERS) {
+        sync_expr_fail(&parser, "out of registers");
+    }
+    if (parser.error) {
+        fprintf(stderr, "Sync expression '%s': %s at column %d\n", source, parser.error, (int)(parser.p - source) + 1);
+        memset(expr, 0, sizeof(*expr));
+        return -1;
+    }
+    
+    for (uint32_t i = 0; i < expr->code_count; i++) {
+        SyncExprOp* code = &expr->code[i];
+        code->dst = sync_expr_register(expr, code->dst);
+        code->a = sync_expr_register(expr, code->a);
+        code->b = sync_expr_register(expr, code->b);
+    }
+    expr->result = sync_expr_register(expr, result);
+    expr->register_count = (uint8_t)(SYNC_EXPR_INPUTS + expr->track_count + expr->constant_count + parser.max_temps);
+    return 0;
+}
+
+// inputs holds SYNC_EXPR_INPUTS values; track_values is indexed by handle
+float sync_expr_eval(const SyncExpr* expr, const float* inputs, const float* track_values) {
+    float r[SYNC_EXPR_REGISTERS];
+    uint32_t base = SYNC_EXPR_INPUTS;
+    
+    memcpy(r, inputs, SYNC_EXPR_INPUTS * sizeof(float));
+    for (uint32_t j = 0; j < expr->track_count; j++) {
+        r[base + j] = track_values[expr->tracks[j]];
+    }
+    base += expr->track_count;
+    memcpy(r + base, expr->constants, expr->constant_count * sizeof(float));
+    
+    const SyncExprOp* end = expr->code + expr->code_count;
+    for (const SyncExprOp* op = expr->code; op < end; op++) {
+        float a = r[op->a];
+        float b = r[op->b];
+        switch (op->op) {
+            case SYNC_OP_ADD: r[op->dst] = a + b; break;
+            case SYNC_OP_SUB: r[op->dst] = a - b; break;
+            case SYNC_OP_MUL: r[op->dst] = a * b; break;
+            case SYNC_OP_DIV: r[op->dst] = a / b; break;
+            case SYNC_OP_MOD: r[op->dst] = fmodf(a, b); break;
+            case SYNC_OP_MIN: r[op->dst] = fminf(a, b); break;
+            case SYNC_OP_MAX: r[op->dst] = fmaxf(a, b); break;
+            case SYNC_OP_POW: r[op->dst] = powf(a, b); break;
+            case SYNC_OP_STEP: r[op->dst] = (b < a) ? 0.0f : 1.0f; break;
+            case SYNC_OP_NEG: r[op->dst] = -a; break;
+            case SYNC_OP_SIN: r[op->dst] = sinf(a); break;
+            case SYNC_OP_COS: r[op->dst] = cosf(a); break;
+            case SYNC_OP_ABS: r[op->dst] = fabsf(a); break;
+            case SYNC_OP_FLOOR: r[op->dst] = floorf(a); break;
+            case SYNC_OP_FRACT: r[op->dst] = a - floorf(a); break;
+            case SYNC_OP_SQRT: r[op->dst] = sqrtf(a); break;
+        }
+    }
+    return r[expr->result];
+}
+
+// Evaluates count frames, at most SYNC_EXPR_BLOCK, one instruction at a
+// time across all of them. inputs[i] is the column for input i and
+// tracks[j] the column for the track in expr->tracks[j].
+void sync_expr_eval_block(const SyncExpr* expr, const float* const* inputs, const float* const* tracks, float* out, uint32_t count) {
+    float scratch[SYNC_EXPR_REGISTERS][SYNC_EXPR_BLOCK];
+    const float* r[SYNC_EXPR_REGISTERS];
+    uint32_t base = SYNC_EXPR_INPUTS;
+    
+    for (uint32_t i = 0; i < SYNC_EXPR_INPUTS; i++) {
+        r[i] = inputs[i];
+    }
+    for (uint32_t j = 0; j < expr->track_count; j++) {
+        r[base + j] = tracks[j];
+    }
+    base += expr->track_count;
+    for (uint32_t k = 0; k < expr->constant_count; k++) {
+        for (uint32_t i = 0; i < count; i++) {
+            scratch[base + k][i] = expr->constants[k];
+        }
+        r[base + k] = scratch[base + k];
+    }
+    for (uint32_t reg = base + expr->constant_count; reg < expr->register_count; reg++) {
+        r[reg] = scratch[reg];
+    }
+    
+    const SyncExprOp* end = expr->code + expr->code_count;
+    for (const SyncExprOp* op = expr->code; op < end; op++) {
+        const float* a = r[op->a];
+        const float* b = r[op->b];
+        float* d = scratch[op->dst];
+        uint32_t i;
+        switch (op->op) {
+            case SYNC_OP_ADD: for (i = 0; i < count; i++) d[i] = a[i] + b[i]; break;
+            case SYNC_OP_SUB: for (i = 0; i < count; i++) d[i] = a[i] - b[i]; break;
+            case SYNC_OP_MUL: for (i = 0; i < count; i++) d[i] = a[i] * b[i]; break;
+            case SYNC_OP_DIV: for (i = 0; i < count; i++) d[i] = a[i] / b[i]; break;
+            case SYNC_OP_MOD: for (i = 0; i < count; i++) d[i] = fmodf(a[i], b[i]); break;
+            case SYNC_OP_MIN: for (i = 0; i < count; i++) d[i] = fminf(a[i], b[i]); break;
+            case SYNC_OP_MAX: for (i = 0; i < count; i++) d[i] = fmaxf(a[i], b[i]); break;
+            case SYNC_OP_POW: for (i = 0; i < count; i++) d[i] = powf(a[i], b[i]); break;
+            case SYNC_OP_STEP: for (i = 0; i < count; i++) d[i] = (b[i] < a[i]) ? 0.0f : 1.0f; break;
+            case SYNC_OP_NEG: for (i = 0; i < count; i++) d[i] = -a[i]; break;
+            case SYNC_OP_SIN: for (i = 0; i < count; i++) d[i] = sinf(a[i]); break;
+            case SYNC_OP_COS: for (i = 0; i < count; i++) d[i] = cosf(a[i]); break;
+            case SYNC_OP_ABS: for (i = 0; i < count; i++) d[i] = fabsf(a[i]); break;
+            case SYNC_OP_FLOOR: for (i = 0; i < count; i++) d[i] = floorf(a[i]); break;
+            case SYNC_OP_FRACT: for (i = 0; i < count; i++) d[i] = a[i] - floorf(a[i]); break;
+            case SYNC_OP_SQRT: for (i = 0; i < count; i++) d[i] = sqrtf(a[i]); break;
+        }
+    }
+    memcpy(out, r[expr->result], count * sizeof(float));
+}
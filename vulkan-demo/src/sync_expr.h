@@ -0,0 +1,53 @@
+#ifndef SYNC_EXPR_H
+#define SYNC_EXPR_H
+
+#include <stdint.h>
+
+#define SYNC_EXPR_MAX_CODE 32
+#define SYNC_EXPR_MAX_CONSTANTS 16
+#define SYNC_EXPR_MAX_TRACKS 8
+#define SYNC_EXPR_REGISTERS 32
+// Frames per block in sync_expr_eval_block()
+#define SYNC_EXPR_BLOCK 64
+
+// Values every expression can read by name
+typedef enum {
+    SYNC_EXPR_TIME,
+    SYNC_EXPR_BEAT,
+    SYNC_EXPR_ROW,
+    SYNC_EXPR_BASS,
+    SYNC_EXPR_MID,
+    SYNC_EXPR_HIGH,
+    SYNC_EXPR_INTENSITY,
+    SYNC_EXPR_INPUTS
+} SyncExprInput;
+
+typedef struct {
+    uint8_t op;
+    uint8_t dst;
+    uint8_t a;
+    uint8_t b;
+} SyncExprOp;
+
+// An expression compiled for a register machine. The registers start with
+// the inputs, then the tracks the expression reads, then its constants, so
+// instructions never load anything; the temporaries come after those.
+typedef struct {
+    SyncExprOp code[SYNC_EXPR_MAX_CODE];
+    float constants[SYNC_EXPR_MAX_CONSTANTS];
+    int16_t tracks[SYNC_EXPR_MAX_TRACKS];
+    uint8_t code_count;
+    uint8_t constant_count;
+    uint8_t track_count;
+    uint8_t register_count;
+    uint8_t result;
+} SyncExpr;
+
+// Maps a name that is not an input to a track handle, or -1
+typedef int (*SyncExprResolve)(void* user, const char* name);
+
+int sync_expr_compile(SyncExpr* expr, const char* source, SyncExprResolve resolve, void* user);
+float sync_expr_eval(const SyncExpr* expr, const float* inputs, const float* track_values);
+void sync_expr_eval_block(const SyncExpr* expr, const float* const* inputs, const float* const* tracks, float* out, uint32_t count);
+
+#endif
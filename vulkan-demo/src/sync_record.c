@@ -0,0 +1,206 @@
+#include "sync_record.h"
+#include <string.h>
+
+#define SYNC_RECORD_MAGIC 0x43455253u
+#define SYNC_RECORD_VERSION 1
+#define SYNC_RECORD_TRACKED_BEAT 1u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sync_size;
+    uint32_t uniform_size;
+    uint32_t frame_size;
+    uint32_t reserved[3];
+} SyncRecordHeader;
+
+// Start of every frame; the uniform block follows it
+typedef struct {
+    float dt;
+    uint32_t flags;
+    SyncData data;
+} SyncRecordHead;
+
+static uint32_t sync_record_frame_size(uint32_t uniform_size) {
+    return ((uint32_t)sizeof(SyncRecordHead) + uniform_size + 3) & ~3u;
+}
+
+int sync_record_open(SyncRecorder* recorder, const char* filename, uint32_t uniform_size) {
+    SyncRecordHeader header;
+    
+    memset(recorder, 0, sizeof(*recorder));
+    recorder->uniform_size = uniform_size;
+    recorder->frame_size = sync_record_frame_size(uniform_size);
+    if (recorder->frame_size > SYNC_RECORD_MAX_FRAME) {
+        fprintf(stderr, "Sync record frame of %u bytes is too large\n", recorder->frame_size);
+        return -1;
+    }
+    
+    recorder->file = fopen(filename, "wb");
+    if (!recorder->file) {
+        fprintf(stderr, "Failed to open sync record: %s\n", filename);
+        return -1;
+    }
+    
+    memset(&header, 0, sizeof(header));
+    header.magic = SYNC_RECORD_MAGIC;
+    header.version = SYNC_RECORD_VERSION;
+    header.sync_size = sizeof(SyncData);
+    header.uniform_size = uniform_size;
+    header.frame_size = recorder->frame_size;
+    if (fwrite(&header, sizeof(header), 1, recorder->file) != 1) {
+        fprintf(stderr, "Failed to write sync record: %s\n", filename);
+        fclose(recorder->file);
+        recorder->file = NULL;
+        return -1;
+    }
+    
+    recorder->bytes = sizeof(header);
+    recorder->mode = SYNC_RECORD_WRITE;
+    return 0;
+}
+
+int sync_replay_open(SyncRecorder* recorder, const char* filename, uint32_t uniform_size) {
+    memset(recorder, 0, sizeof(*recorder));
+    if (file_map_open(&recorder->mapping, filename) != 0) {
+        fprintf(stderr, "Failed to open sync record: %s\n", filename);
+        return -1;
+    }
+    
+    const SyncRecordHeader* header = recorder->mapping.data;
+    if (recorder->mapping.size < sizeof(SyncRecordHeader) ||
+        header->magic != SYNC_RECORD_MAGIC || header->version != SYNC_RECORD_VERSION ||
+        header->sync_size != sizeof(SyncData) || header->uniform_size != uniform_size ||
+        header->frame_size != sync_record_frame_size(uniform_size) || header->frame_size > SYNC_RECORD_MAX_FRAME) {
+        fprintf(stderr, "Sync record %s does not match this build\n", filename);
+        file_map_close(&recorder->mapping);
+        return -1;
+    }
+    
+    recorder->uniform_size = uniform_size;
+    recorder->frame_size = header->frame_size;
+    recorder->cursor = (const uint8_t*)(header + 1);
+    recorder->end = (const uint8_t*)recorder->mapping.data + recorder->mapping.size;
+    recorder->mode = SYNC_RECORD_REPLAY;
+    return 0;
+}
+
+static void sync_record_write_frame(SyncRecorder* recorder) {
+    uint32_t words = recorder->frame_size / 4;
+    uint8_t bitmap[SYNC_RECORD_MAX_FRAME / 32];
+    uint32_t changed[SYNC_RECORD_MAX_FRAME / 4];
+    uint32_t count = 0;
+    
+    memset(bitmap, 0, sizeof(bitmap));
+    for (uint32_t w = 0; w < words; w++) {
+        uint32_t now;
+        uint32_t before;
+        memcpy(&now, recorder->frame + w * 4, 4);
+        memcpy(&before, recorder->previous + w * 4, 4);
+        if (now != before) {
+            bitmap[w / 8] |= (uint8_t)(1u << (w % 8));
+            changed[count++] = now ^ before;
+        }
+    }
+    
+    uint32_t bitmap_size = (words + 7) / 8;
+    if (fwrite(bitmap, 1, bitmap_size, recorder->file) != bitmap_size ||
+        fwrite(changed, 4, count, recorder->file) != count) {
+        fprintf(stderr, "Failed to write sync record, stopping\n");
+        fclose(recorder->file);
+        recorder->file = NULL;
+        recorder->mode = SYNC_RECORD_OFF;
+        return;
+    }
+    
+    memcpy(recorder->previous, recorder->frame, recorder->frame_size);
+    recorder->bytes += bitmap_size + count * 4;
+    recorder->frames++;
+    recorder->pending = false;
+}
+
+void sync_record_close(SyncRecorder* recorder) {
+    if (recorder->mode == SYNC_RECORD_WRITE) {
+        if (recorder->pending) {
+            sync_record_write_frame(recorder);
+        }
+        if (recorder->file) {
+            fclose(recorder->file);
+            printf("Recorded %u frames of sync, %.1f bytes per frame\n",
+                   recorder->frames, recorder->frames ? (double)recorder->bytes / recorder->frames : 0.0);
+        }
+    } else if (recorder->mode == SYNC_RECORD_REPLAY) {
+        file_map_close(&recorder->mapping);
+    }
+    recorder->file = NULL;
+    recorder->mode = SYNC_RECORD_OFF;
+}
+
+// Starts the frame after a sync_update(). It is written out once the next
+// frame begins, so a frame whose uniforms were never set keeps the last.
+void sync_record_begin(SyncRecorder* recorder, const RocketSync* sync, float dt) {
+    if (recorder->mode != SYNC_RECORD_WRITE) {
+        return;
+    }
+    if (recorder->pending) {
+        sync_record_write_frame(recorder);
+    }
+    
+    SyncRecordHead head;
+    memset(&head, 0, sizeof(head));
+    head.dt = dt;
+    head.flags = sync->tracked_beat ? SYNC_RECORD_TRACKED_BEAT : 0;
+    head.data = sync->current;
+    memcpy(recorder->frame, &head, sizeof(head));
+    recorder->pending = true;
+}
+
+// Decodes the next frame and feeds it to sync in place of sync_update().
+// Returns false at the end of the log.
+bool sync_replay_begin(SyncRecorder* recorder, RocketSync* sync, float* dt) {
+    uint32_t words = recorder->frame_size / 4;
+    uint32_t bitmap_size = (words + 7) / 8;
+    const uint8_t* bitmap = recorder->cursor;
+    
+    if (recorder->mode != SYNC_RECORD_REPLAY || (size_t)(recorder->end - recorder->cursor) < bitmap_size) {
+        return false;
+    }
+    
+    const uint8_t* changed = bitmap + bitmap_size;
+    for (uint32_t w = 0; w < words; w++) {
+        if (bitmap[w / 8] & (1u << (w % 8))) {
+            uint32_t delta;
+            uint32_t word;
+            if (recorder->end - changed < 4) {
+                fprintf(stderr, "Sync record is truncated\n");
+                return false;
+            }
+            memcpy(&delta, changed, 4);
+            memcpy(&word, recorder->frame + w * 4, 4);
+            word ^= delta;
+            memcpy(recorder->frame + w * 4, &word, 4);
+            changed += 4;
+        }
+    }
+    recorder->cursor = changed;
+    recorder->frames++;
+    
+    SyncRecordHead head;
+    memcpy(&head, recorder->frame, sizeof(head));
+    sync_update_replay(sync, &head.data, (head.flags & SYNC_RECORD_TRACKED_BEAT) != 0, head.dt);
+    *dt = head.dt;
+    return true;
+}
+
+// Recording stores the frame's uniform block; replaying overwrites it with
+// the recorded one
+void sync_record_uniforms(SyncRecorder* recorder, void* uniforms, uint32_t size) {
+    if (size != recorder->uniform_size) {
+        return;
+    }
+    if (recorder->mode == SYNC_RECORD_WRITE) {
+        memcpy(recorder->frame + sizeof(SyncRecordHead), uniforms, size);
+    } else if (recorder->mode == SYNC_RECORD_REPLAY) {
+        memcpy(uniforms, recorder->frame + sizeof(SyncRecordHead), size);
+    }
+}
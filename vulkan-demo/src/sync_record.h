@@ -0,0 +1,41 @@
+#ifndef SYNC_RECORD_H
+#define SYNC_RECORD_H
+
+#include "sync_system.h"
+#include "file_map.h"
+#include <stdio.h>
+
+#define SYNC_RECORD_MAX_FRAME 1024
+
+typedef enum {
+    SYNC_RECORD_OFF,
+    SYNC_RECORD_WRITE,
+    SYNC_RECORD_REPLAY
+} SyncRecordMode;
+
+// Per-frame log of the sync state and the uniform block. Each frame is
+// stored as the XOR against the one before it: a bitmap of the 32-bit
+// words that changed, then just those words.
+struct SyncRecorder {
+    SyncRecordMode mode;
+    FILE* file;
+    FileMapping mapping;
+    const uint8_t* cursor;
+    const uint8_t* end;
+    uint32_t uniform_size;
+    uint32_t frame_size;
+    bool pending;
+    uint32_t frames;
+    uint64_t bytes;
+    uint8_t frame[SYNC_RECORD_MAX_FRAME];
+    uint8_t previous[SYNC_RECORD_MAX_FRAME];
+};
+
+int sync_record_open(SyncRecorder* recorder, const char* filename, uint32_t uniform_size);
+int sync_replay_open(SyncRecorder* recorder, const char* filename, uint32_t uniform_size);
+void sync_record_close(SyncRecorder* recorder);
+void sync_record_begin(SyncRecorder* recorder, const RocketSync* sync, float dt);
+bool sync_replay_begin(SyncRecorder* recorder, RocketSync* sync, float* dt);
+void sync_record_uniforms(SyncRecorder* recorder, void* uniforms, uint32_t size);
+
+#endif
@@ -1,11 +1,77 @@
 #include "sync_system.h"
+#include "platform.h"
+#include "audio_simd.h"
+#include <stdio.h>
 #include <string.h>
+#include <float.h>
 #include <math.h>
 
+#define SYNC_BPM 140.0f
+// How many track references sync_eval_frames() follows
+#define SYNC_FRAMES_DEPTH 3
+
+// GNU Rocket editor protocol. Integers are big-endian on the wire and
+// floats travel as their bit patterns.
+#define ROCKET_SET_KEY 0
+#define ROCKET_DELETE_KEY 1
+#define ROCKET_GET_TRACK 2
+#define ROCKET_SET_ROW 3
+#define ROCKET_PAUSE 4
+#define ROCKET_SAVE_TRACKS 5
+
+static const char rocket_client_greeting[] = "hello, synctracker!";
+static const char rocket_server_greeting[] = "hello, demo!";
+
+typedef enum {
+    SYNC_VALUE_NONE,
+    SYNC_VALUE_EXPR,
+    SYNC_VALUE_KEYS
+} SyncValueKind;
+
+// Tracks registered by sync_init(), in handle order
+static const struct {
+    const char* name;
+    const char* expression;
+    uint8_t trigger;
+} sync_builtin_tracks[] = {
+    {"intensity", "intensity", SYNC_TRIGGER_NONE},
+    {"bass", "bass", SYNC_TRIGGER_NONE},
+    {"mid", "mid", SYNC_TRIGGER_NONE},
+    {"high", "high", SYNC_TRIGGER_NONE},
+    {"beat", "fract(beat)", SYNC_TRIGGER_BEAT},
+    {"bar", "floor(beat / 4)", SYNC_TRIGGER_BAR},
+    {"pattern", "floor(row / 64) % 8", SYNC_TRIGGER_PATTERN},
+    {"time", "time", SYNC_TRIGGER_NONE},
+    {"kick", NULL, SYNC_TRIGGER_KICK},
+    {"snare", NULL, SYNC_TRIGGER_SNARE},
+    {"hihat", NULL, SYNC_TRIGGER_HIHAT},
+    {"tracked_beat", NULL, SYNC_TRIGGER_TRACKED_BEAT}
+};
+
+// Defaults for other names, picked by substring
+static const struct {
+    const char* pattern;
+    const char* expression;
+} sync_fallback_tracks[] = {
+    {"rotate", "time * 0.5"},
+    {"pulse", "sin(time * 2) * 0.5 + 0.5"},
+    {"wave", "sin(beat * 0.5) * 0.5 + 0.5"}
+};
+
 static float lerp(float a, float b, float t) {
     return a + t * (b - a);
 }
 
+// FNV-1a over the part of the name that is stored, so a long name and
+// its truncated copy in names[] land on the same slot
+static uint32_t sync_hash_name(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < SYNC_TRACK_NAME - 1 && name[i]; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
 void sync_init(RocketSync* sync) {
     memset(sync, 0, sizeof(RocketSync));
     sync->current.time = 0.0f;
@@ -20,13 +86,559 @@ void sync_init(RocketSync* sync) {
     sync->current.kick = false;
     sync->current.snare = false;
     sync->current.hihat = false;
+    sync->editor.handle = -1;
+    sync->editor_row = -1;
+    sync->sample_rate = SYNC_SAMPLE_RATE;
+    sync->timeline = timeline_demo();
+    timeline_query(sync->timeline, &sync->timeline_cursor, 0.0f, &sync->scene);
+    
+    for (size_t i = 0; i < sizeof(sync_builtin_tracks) / sizeof(sync_builtin_tracks[0]); i++) {
+        sync_track(sync, sync_builtin_tracks[i].name);
+    }
+}
+
+void sync_cleanup(RocketSync* sync) {
+    sync_editor_disconnect(sync);
+    for (uint32_t h = 0; h < sync->tracks.count; h++) {
+        sync_key_track_free(&sync->tracks.keys[h]);
+    }
+    sync->tracks.count = 0;
+    memset(sync->tracks.slots, 0, sizeof(sync->tracks.slots));
+    file_map_close(&sync->export_mapping);
+}
+
+void sync_attach_onsets(RocketSync* sync, OnsetQueue* onsets) {
+    sync->onsets = onsets;
+    sync->beat_pending = false;
+    sync->tracked_beat = false;
+}
+
+static void sync_drain_onsets(RocketSync* sync, AudioEngine* audio, bool* kick, bool* snare) {
+    OnsetEvent event;
+    while (onset_queue_pop(sync->onsets, &event)) {
+        switch (event.type) {
+            case ONSET_EVENT_KICK:
+                *kick = true;
+                sync->stamps[SYNC_TRIGGER_KICK] = event.sample_pos;
+                sync->stamped |= SYNC_TRIGGER_BIT(SYNC_TRIGGER_KICK);
+                break;
+            case ONSET_EVENT_SNARE:
+                *snare = true;
+                sync->stamps[SYNC_TRIGGER_SNARE] = event.sample_pos;
+                sync->stamped |= SYNC_TRIGGER_BIT(SYNC_TRIGGER_SNARE);
+                break;
+            case ONSET_EVENT_BEAT:
+                // Beats arrive ahead of time; hold the newest prediction
+                // until the audio reaches it
+                sync->next_beat_pos = event.sample_pos;
+                sync->beat_pending = true;
+                sync->tempo = event.tempo;
+                break;
+        }
+    }
+    
+    uint32_t now = atomic_load_u32(&audio->ring_write);
+    sync->tracked_beat = sync->beat_pending && (int32_t)(now - sync->next_beat_pos) >= 0;
+    if (sync->tracked_beat) {
+        sync->beat_pending = false;
+        sync->stamps[SYNC_TRIGGER_TRACKED_BEAT] = sync->next_beat_pos;
+        sync->stamped |= SYNC_TRIGGER_BIT(SYNC_TRIGGER_TRACKED_BEAT);
+    }
+}
+
+// Expression inputs at time. The audio inputs are the latest update's,
+// crossfaded while a transition runs.
+static void sync_eval_inputs(const RocketSync* sync, float time, float* inputs) {
+    float t = sync->transition_active ? 1.0f - (sync->transition_time / 2.0f) : 1.0f;
+    
+    inputs[SYNC_EXPR_TIME] = time;
+    inputs[SYNC_EXPR_BEAT] = time * (SYNC_BPM / 60.0f);
+    inputs[SYNC_EXPR_ROW] = time / (60.0f / (SYNC_BPM * SYNC_ROWS_PER_BEAT));
+    // Paused, the editor's row is the row, so keys on its cursor show
+    if (sync->editor_connected && sync->editor_paused && sync->editor_row >= 0 && time == sync->current.time) {
+        inputs[SYNC_EXPR_ROW] = (float)sync->editor_row;
+    }
+    inputs[SYNC_EXPR_BASS] = lerp(sync->previous.bass, sync->current.bass, t);
+    inputs[SYNC_EXPR_MID] = lerp(sync->previous.mid, sync->current.mid, t);
+    inputs[SYNC_EXPR_HIGH] = lerp(sync->previous.high, sync->current.high, t);
+    inputs[SYNC_EXPR_INTENSITY] = lerp(sync->previous.intensity, sync->current.intensity, t);
+}
+
+// Loads the keyframe segment around row: a hold before the first key and
+// after the last, otherwise the interpolation between the two keys around
+// it expanded into cubic coefficients
+static void sync_load_segment(SyncTracks* tracks, uint32_t h, float row) {
+    const SyncKeyTrack* keys = &tracks->keys[h];
+    float start = -FLT_MAX;
+    float end = FLT_MAX;
+    float scale = 0.0f;
+    float c0 = 0.0f;
+    float delta = 0.0f;
+    uint8_t type = SYNC_KEY_STEP;
+    
+    if (keys->count > 0) {
+        uint32_t k = sync_key_track_seek(keys, row);
+        c0 = keys->values[k];
+        if (row < (float)keys->rows[k]) {
+            end = (float)keys->rows[k];
+        } else {
+            start = (float)keys->rows[k];
+            if (k + 1 < keys->count) {
+                end = (float)keys->rows[k + 1];
+                scale = 1.0f / (end - start);
+                delta = keys->values[k + 1] - c0;
+                type = keys->types[k];
+            }
+        }
+    }
+    
+    tracks->seg_start[h] = start;
+    tracks->seg_end[h] = end;
+    tracks->seg_scale[h] = scale;
+    tracks->seg_c0[h] = c0;
+    tracks->seg_c1[h] = (type == SYNC_KEY_LINEAR) ? delta : 0.0f;
+    tracks->seg_c2[h] = (type == SYNC_KEY_SMOOTH) ? 3.0f * delta : (type == SYNC_KEY_RAMP) ? delta : 0.0f;
+    tracks->seg_c3[h] = (type == SYNC_KEY_SMOOTH) ? -2.0f * delta : 0.0f;
+}
+
+// Evaluates every track at time into out[handle], as laid out for a
+// std140 vec4 array. Slots past the registered tracks are written as 0.
+void sync_eval_batch(RocketSync* sync, float time, float* out, uint32_t count) {
+    SyncTracks* tracks = &sync->tracks;
+    float inputs[SYNC_EXPR_INPUTS];
+    
+    sync_eval_inputs(sync, time, inputs);
+    float row = inputs[SYNC_EXPR_ROW];
+    for (uint32_t h = 0; h < tracks->count; h++) {
+        uint8_t kind = tracks->value_kinds[h];
+        if (kind == SYNC_VALUE_EXPR) {
+            tracks->seg_c0[h] = sync_expr_eval(&tracks->exprs[h], inputs, tracks->values);
+        } else if (kind == SYNC_VALUE_KEYS && (row < tracks->seg_start[h] || row >= tracks->seg_end[h])) {
+            sync_load_segment(tracks, h, row);
+        }
+    }
+    
+    uint32_t lanes = (tracks->count < count) ? tracks->count : count;
+    uint32_t h = 0;
+#ifdef AUDIO_SIMD_SSE
+    __m128 r = _mm_set1_ps(row);
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    for (; h + 4 <= lanes; h += 4) {
+        __m128 t = _mm_mul_ps(_mm_sub_ps(r, _mm_loadu_ps(tracks->seg_start + h)), _mm_loadu_ps(tracks->seg_scale + h));
+        t = _mm_min_ps(_mm_max_ps(t, zero), one);
+        __m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(tracks->seg_c3 + h), t), _mm_loadu_ps(tracks->seg_c2 + h));
+        v = _mm_add_ps(_mm_mul_ps(v, t), _mm_loadu_ps(tracks->seg_c1 + h));
+        v = _mm_add_ps(_mm_mul_ps(v, t), _mm_loadu_ps(tracks->seg_c0 + h));
+        _mm_storeu_ps(out + h, v);
+    }
+#endif
+    for (; h < lanes; h++) {
+        float t = fminf(fmaxf((row - tracks->seg_start[h]) * tracks->seg_scale[h], 0.0f), 1.0f);
+        out[h] = tracks->seg_c0[h] + t * (tracks->seg_c1[h] + t * (tracks->seg_c2[h] + t * tracks->seg_c3[h]));
+    }
+    for (; h < count; h++) {
+        out[h] = 0.0f;
+    }
+}
+
+// Expression inputs for frames away from the current one. Audio inputs
+// come from the precalculated envelopes when there are any, as in
+// sync_update(), and otherwise hold their current values.
+static void sync_frame_inputs(const RocketSync* sync, float time, float** columns, uint32_t i) {
+    float inputs[SYNC_EXPR_INPUTS];
+    sync_eval_inputs(sync, time, inputs);
+    
+    if (sync->envelopes) {
+        const AudioEnvelopeTracks* env = sync->envelopes;
+        inputs[SYNC_EXPR_BASS] = audio_envelope_value(env, AUDIO_STEM_KICK, AUDIO_ENV_RMS, time);
+        inputs[SYNC_EXPR_MID] = audio_envelope_value(env, AUDIO_STEM_BASS, AUDIO_ENV_RMS, time);
+        inputs[SYNC_EXPR_HIGH] = fmaxf(audio_envelope_value(env, AUDIO_STEM_LEAD, AUDIO_ENV_RMS, time),
+                                       audio_envelope_value(env, AUDIO_STEM_HIHAT, AUDIO_ENV_RMS, time));
+        TimelineCursor cursor = sync->timeline_cursor;
+        TimelinePoint scene;
+        timeline_query(sync->timeline, &cursor, time, &scene);
+        inputs[SYNC_EXPR_INTENSITY] = 0.5f + scene.progress * 0.5f;
+    }
+    for (uint32_t k = 0; k < SYNC_EXPR_INPUTS; k++) {
+        columns[k][i] = inputs[k];
+    }
+}
+
+static void sync_eval_frames_nested(RocketSync* sync, int handle, float start, float step, float* out, uint32_t count, int depth) {
+    SyncTracks* tracks = &sync->tracks;
+    float input_storage[SYNC_EXPR_INPUTS][SYNC_EXPR_BLOCK];
+    float track_storage[SYNC_EXPR_MAX_TRACKS][SYNC_EXPR_BLOCK];
+    float* inputs[SYNC_EXPR_INPUTS];
+    float* columns[SYNC_EXPR_MAX_TRACKS];
+    
+    for (uint32_t k = 0; k < SYNC_EXPR_INPUTS; k++) {
+        inputs[k] = input_storage[k];
+    }
+    for (uint32_t j = 0; j < SYNC_EXPR_MAX_TRACKS; j++) {
+        columns[j] = track_storage[j];
+    }
+    
+    for (uint32_t done = 0; done < count; done += SYNC_EXPR_BLOCK) {
+        uint32_t block = (count - done < SYNC_EXPR_BLOCK) ? count - done : SYNC_EXPR_BLOCK;
+        float block_start = start + step * (float)done;
+        
+        if (tracks->value_kinds[handle] == SYNC_VALUE_KEYS) {
+            float rows_per_second = SYNC_BPM / 60.0f * SYNC_ROWS_PER_BEAT;
+            for (uint32_t i = 0; i < block; i++) {
+                out[done + i] = sync_key_track_eval(&tracks->keys[handle], (block_start + step * (float)i) * rows_per_second);
+            }
+        } else if (tracks->value_kinds[handle] == SYNC_VALUE_EXPR) {
+            const SyncExpr* expr = &tracks->exprs[handle];
+            for (uint32_t i = 0; i < block; i++) {
+                sync_frame_inputs(sync, block_start + step * (float)i, inputs, i);
+            }
+            // Tracks read the same frames, except self-references and
+            // chains too deep to follow, which hold their current value
+            for (uint32_t j = 0; j < expr->track_count; j++) {
+                int ref = expr->tracks[j];
+                if (ref != handle && depth > 0) {
+                    sync_eval_frames_nested(sync, ref, block_start, step, columns[j], block, depth - 1);
+                } else {
+                    for (uint32_t i = 0; i < block; i++) {
+                        columns[j][i] = tracks->values[ref];
+                    }
+                }
+            }
+            sync_expr_eval_block(expr, (const float* const*)inputs, (const float* const*)columns, out + done, block);
+        } else {
+            memset(out + done, 0, block * sizeof(float));
+        }
+    }
+}
+
+// Evaluates one track over count frames from start, step seconds apart,
+// for precalc and export. Expressions run a block of frames per
+// instruction; triggers are not covered.
+void sync_eval_frames(RocketSync* sync, int handle, float start, float step, float* out, uint32_t count) {
+    if (handle < 0 || (uint32_t)handle >= sync->tracks.count) {
+        memset(out, 0, count * sizeof(float));
+        return;
+    }
+    sync_eval_frames_nested(sync, handle, start, step, out, count, SYNC_FRAMES_DEPTH);
+}
+
+// Steps every value to the current time, once per update
+static void sync_refresh_values(RocketSync* sync) {
+    sync_eval_batch(sync, sync->current.time, sync->tracks.values, sync->tracks.count);
+}
+
+// Brings one value up to date after its track was added, defined or had
+// its keys changed. Self-referencing expressions are left to the next
+// update, since every evaluation steps their feedback.
+static void sync_refresh_track(RocketSync* sync, int handle) {
+    SyncTracks* tracks = &sync->tracks;
+    float inputs[SYNC_EXPR_INPUTS];
+    sync_eval_inputs(sync, sync->current.time, inputs);
+    
+    if (tracks->value_kinds[handle] == SYNC_VALUE_EXPR) {
+        const SyncExpr* expr = &tracks->exprs[handle];
+        for (uint32_t j = 0; j < expr->track_count; j++) {
+            if (expr->tracks[j] == handle) {
+                return;
+            }
+        }
+        tracks->values[handle] = sync_expr_eval(expr, inputs, tracks->values);
+        return;
+    }
+    
+    float row = inputs[SYNC_EXPR_ROW];
+    sync_load_segment(tracks, (uint32_t)handle, row);
+    float t = fminf(fmaxf((row - tracks->seg_start[handle]) * tracks->seg_scale[handle], 0.0f), 1.0f);
+    tracks->values[handle] = tracks->seg_c0[handle] + t * (tracks->seg_c1[handle] + t * (tracks->seg_c2[handle] + t * tracks->seg_c3[handle]));
+}
+
+// Every gate's state for the current SyncData, one bit each
+static uint64_t sync_eval_levels(const RocketSync* sync) {
+    uint64_t levels = 0;
+    levels |= sync->current.kick ? SYNC_TRIGGER_BIT(SYNC_TRIGGER_KICK) : 0;
+    levels |= sync->current.snare ? SYNC_TRIGGER_BIT(SYNC_TRIGGER_SNARE) : 0;
+    levels |= sync->current.hihat ? SYNC_TRIGGER_BIT(SYNC_TRIGGER_HIHAT) : 0;
+    levels |= sync->tracked_beat ? SYNC_TRIGGER_BIT(SYNC_TRIGGER_TRACKED_BEAT) : 0;
+    return levels;
+}
+
+// Counters that moved since the last update. A seek or a long frame can
+// step one by an even amount, so this compares counts rather than parity.
+static uint64_t sync_eval_steps(const RocketSync* sync) {
+    uint64_t steps = 0;
+    steps |= ((int)sync->current.beat != (int)sync->previous.beat) ? SYNC_TRIGGER_BIT(SYNC_TRIGGER_BEAT) : 0;
+    steps |= (sync->current.bar != sync->previous.bar) ? SYNC_TRIGGER_BIT(SYNC_TRIGGER_BAR) : 0;
+    steps |= (sync->current.pattern != sync->previous.pattern) ? SYNC_TRIGGER_BIT(SYNC_TRIGGER_PATTERN) : 0;
+    return steps;
+}
+
+// Ring position at which sync time was time, counting back from this update
+static uint32_t sync_sample_at(const RocketSync* sync, float time) {
+    float behind = (sync->current.time - time) * sync->sample_rate;
+    return sync->sample_pos - (uint32_t)fmaxf(behind, 0.0f);
+}
+
+// Where an edge without an exact stamp happened: grid-derived triggers at
+// the row or beat boundary that raised them, the rest at this update
+static uint32_t sync_event_sample(const RocketSync* sync, uint32_t kind) {
+    float beats_per_second = SYNC_BPM / 60.0f;
+    float rows = sync->current.beat * SYNC_ROWS_PER_BEAT;
+    
+    if (sync->stamped & SYNC_TRIGGER_BIT(kind)) {
+        return sync->stamps[kind];
+    }
+    switch (kind) {
+        case SYNC_TRIGGER_HIHAT:
+            return sync_sample_at(sync, floorf(rows) / (SYNC_ROWS_PER_BEAT * beats_per_second));
+        case SYNC_TRIGGER_BEAT:
+            return sync_sample_at(sync, floorf(sync->current.beat) / beats_per_second);
+        case SYNC_TRIGGER_BAR:
+            return sync_sample_at(sync, (float)(sync->current.bar * 4) / beats_per_second);
+        case SYNC_TRIGGER_PATTERN:
+            return sync_sample_at(sync, floorf(rows / 64.0f) * 64.0f / (SYNC_ROWS_PER_BEAT * beats_per_second));
+        default:
+            return sync->sample_pos;
+    }
+}
+
+// Gate edges from one XOR against the last update's levels, counter steps
+// on top, then the event list in bit order
+static void sync_update_triggers(RocketSync* sync) {
+    uint64_t levels = sync_eval_levels(sync);
+    uint64_t changed = levels ^ sync->levels;
+    sync->fired = (changed & levels) | sync_eval_steps(sync);
+    sync->falling = changed & ~levels;
+    sync->levels = levels;
+    
+    sync->event_count = 0;
+    uint64_t edges = sync->fired | sync->falling;
+    for (uint32_t kind = 1; edges && kind < SYNC_TRIGGER_COUNT; kind++) {
+        if (!(edges & SYNC_TRIGGER_BIT(kind)) || sync->event_count >= SYNC_MAX_EVENTS) {
+            continue;
+        }
+        SyncEvent* event = &sync->events[sync->event_count++];
+        event->sample_pos = sync_event_sample(sync, kind);
+        event->kind = (uint8_t)kind;
+        event->rising = (sync->fired & SYNC_TRIGGER_BIT(kind)) != 0;
+        edges &= ~SYNC_TRIGGER_BIT(kind);
+    }
+}
+
+static uint32_t rocket_read_u32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void rocket_write_u32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+// Song time of the start of row. Rounding in the single precision
+// conversions back can land just below it, so the time is nudged up until
+// every row sync_update() derives from it is row again.
+static float sync_row_time(uint32_t row) {
+    float time = (float)((double)row * 60.0 / ((double)SYNC_BPM * SYNC_ROWS_PER_BEAT));
+    float beats_per_second = SYNC_BPM / 60.0f;
+    float row_duration = 60.0f / (SYNC_BPM * SYNC_ROWS_PER_BEAT);
+    while ((uint32_t)(time * beats_per_second * SYNC_ROWS_PER_BEAT) < row || (uint32_t)(time / row_duration) < row) {
+        time = nextafterf(time, FLT_MAX);
+    }
+    return time;
+}
+
+static void sync_editor_send(RocketSync* sync, const uint8_t* message, uint32_t size) {
+    // A stalled editor gets the frame's budget, then is dropped
+    if (platform_socket_send(&sync->editor, message, size, SYNC_EDITOR_BUDGET) != 0) {
+        fprintf(stderr, "WARNING: Lost connection to the Rocket editor\n");
+        sync_editor_disconnect(sync);
+    }
+}
+
+static void sync_editor_request_track(RocketSync* sync, int handle) {
+    const char* name = sync->tracks.names[handle];
+    uint32_t length = (uint32_t)strlen(name);
+    uint8_t message[5 + SYNC_TRACK_NAME];
+    
+    message[0] = ROCKET_GET_TRACK;
+    rocket_write_u32(message + 1, length);
+    memcpy(message + 5, name, length);
+    sync_editor_send(sync, message, 5 + length);
+}
+
+int sync_editor_connect(RocketSync* sync, const char* host, uint16_t port) {
+    char reply[sizeof(rocket_server_greeting) - 1];
+    uint32_t got = 0;
+    
+    if (platform_socket_connect(&sync->editor, host, port) != 0) {
+        return -1;
+    }
+    
+    // The handshake is the only exchange we block on
+    if (platform_socket_send(&sync->editor, rocket_client_greeting, sizeof(rocket_client_greeting) - 1, SYNC_EDITOR_BUDGET) != 0) {
+        platform_socket_close(&sync->editor);
+        return -1;
+    }
+    while (got < sizeof(reply)) {
+        int received = platform_socket_recv(&sync->editor, reply + got, sizeof(reply) - got);
+        if (received <= 0) {
+            break;
+        }
+        got += (uint32_t)received;
+    }
+    if (got < sizeof(reply) || memcmp(reply, rocket_server_greeting, sizeof(reply)) != 0 ||
+        platform_socket_set_blocking(&sync->editor, false) != 0) {
+        fprintf(stderr, "WARNING: %s:%u is not a Rocket editor\n", host, port);
+        platform_socket_close(&sync->editor);
+        return -1;
+    }
+    
+    sync->editor_connected = true;
+    sync->editor_paused = false;
+    sync->editor_row = -1;
+    sync->editor_fill = 0;
+    for (uint32_t h = 0; h < sync->tracks.count && sync->editor_connected; h++) {
+        sync_editor_request_track(sync, (int)h);
+    }
+    printf("Connected to Rocket editor at %s:%u\n", host, port);
+    return sync->editor_connected ? 0 : -1;
+}
+
+void sync_editor_disconnect(RocketSync* sync) {
+    platform_socket_close(&sync->editor);
+    sync->editor_connected = false;
+    sync->editor_paused = false;
+    sync->editor_fill = 0;
+}
+
+// Applies every complete message at the front of the buffer and returns the
+// bytes used, or -1 on a command we do not know
+static int sync_editor_handle(RocketSync* sync, const uint8_t* data, uint32_t size) {
+    uint32_t pos = 0;
+    
+    while (pos < size) {
+        const uint8_t* message = data + pos;
+        uint32_t available = size - pos;
+        uint32_t length;
+        
+        switch (message[0]) {
+            case ROCKET_SET_KEY: length = 14; break;
+            case ROCKET_DELETE_KEY: length = 9; break;
+            case ROCKET_SET_ROW: length = 5; break;
+            case ROCKET_PAUSE: length = 2; break;
+            case ROCKET_SAVE_TRACKS: length = 1; break;
+            default: return -1;
+        }
+        if (available < length) {
+            break;
+        }
+        
+        if (message[0] == ROCKET_SET_KEY) {
+            uint32_t bits = rocket_read_u32(message + 9);
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            SyncKeyType type = (message[13] <= SYNC_KEY_RAMP) ? (SyncKeyType)message[13] : SYNC_KEY_STEP;
+            sync_set_key(sync, (int)rocket_read_u32(message + 1), rocket_read_u32(message + 5), value, type);
+        } else if (message[0] == ROCKET_DELETE_KEY) {
+            sync_delete_key(sync, (int)rocket_read_u32(message + 1), rocket_read_u32(message + 5));
+        } else if (message[0] == ROCKET_SET_ROW) {
+            // Seek; set as the last row sent so it is not echoed back
+            uint32_t row = rocket_read_u32(message + 1);
+            sync->current.time = sync_row_time(row);
+            sync->editor_row = (int)row;
+        } else if (message[0] == ROCKET_PAUSE) {
+            sync->editor_paused = message[1] != 0;
+        }
+        pos += length;
+    }
+    return (int)pos;
+}
+
+// Services the editor socket until it runs dry or the budget is spent
+static void sync_editor_poll(RocketSync* sync, double budget) {
+    double deadline = platform_time_seconds() + budget;
+    
+    while (sync->editor_connected) {
+        int received = platform_socket_recv(&sync->editor, sync->editor_buffer + sync->editor_fill, SYNC_EDITOR_BUFFER - sync->editor_fill);
+        if (received < 0) {
+            fprintf(stderr, "WARNING: Rocket editor closed the connection\n");
+            sync_editor_disconnect(sync);
+            return;
+        }
+        sync->editor_fill += (uint32_t)received;
+        
+        int used = sync_editor_handle(sync, sync->editor_buffer, sync->editor_fill);
+        if (used < 0) {
+            fprintf(stderr, "WARNING: Unknown Rocket command %u, disconnecting\n", sync->editor_buffer[0]);
+            sync_editor_disconnect(sync);
+            return;
+        }
+        sync->editor_fill -= (uint32_t)used;
+        memmove(sync->editor_buffer, sync->editor_buffer + used, sync->editor_fill);
+        
+        if (received == 0 || platform_time_seconds() >= deadline) {
+            break;
+        }
+    }
+}
+
+// The rest of an update, once the frame's SyncData is in place
+static void sync_finish_update(RocketSync* sync, float dt) {
+    if (sync->transition_active) {
+        sync->transition_time -= dt;
+        if (sync->transition_time <= 0.0f) {
+            sync->transition_active = false;
+            sync->transition_time = 0.0f;
+        }
+    }
+    
+    // Playing: keep the editor's cursor on our row
+    int editor_row = (int)(sync->current.beat * SYNC_ROWS_PER_BEAT);
+    if (sync->editor_connected && !sync->editor_paused && editor_row != sync->editor_row) {
+        uint8_t message[5];
+        message[0] = ROCKET_SET_ROW;
+        rocket_write_u32(message + 1, (uint32_t)editor_row);
+        sync->editor_row = editor_row;
+        sync_editor_send(sync, message, sizeof(message));
+    }
+    
+    sync_update_triggers(sync);
+    sync_refresh_values(sync);
 }
 
 void sync_update(RocketSync* sync, AudioEngine* audio, float dt) {
+    if (sync->editor_connected) {
+        sync_editor_poll(sync, SYNC_EDITOR_BUDGET);
+        if (sync->editor_paused) {
+            dt = 0.0f;
+        }
+    }
+    
     sync->previous = sync->current;
-    sync->current.time += dt;
+    // Locked to what is audible once the audio clock runs, so beat phase
+    // moves smoothly between callbacks; the editor drives time itself
+    double audible;
+    bool clocked = audio && !sync->editor_connected && audio_clock_read(&audio->clock, platform_time_seconds(), &audible);
+    if (clocked) {
+        sync->current.time = (float)audible;
+    } else {
+        sync->current.time += dt;
+    }
+    sync->stamped = 0;
+    AudioSnapshot snapshot = {0};
+    if (audio) {
+        // The ring runs ahead of what is heard by the output latency;
+        // anchor on the sample the last callback reported audible
+        audio_get_snapshot(audio, &snapshot);
+        sync->sample_rate = audio->sequencer.sample_rate;
+        sync->sample_pos = snapshot.ring_pos + (uint32_t)(int32_t)((sync->current.time - snapshot.time) * sync->sample_rate);
+    } else {
+        sync->sample_pos = (uint32_t)(sync->current.time * sync->sample_rate);
+    }
     
-    float bpm = 140.0f;
+    float bpm = SYNC_BPM;
     float beats_per_second = bpm / 60.0f;
     sync->current.beat = sync->current.time * beats_per_second;
     sync->current.bar = (int)(sync->current.beat / 4.0f);
@@ -36,17 +648,25 @@ void sync_update(RocketSync* sync, AudioEngine* audio, float dt) {
     sync->current.row = total_rows % 64;
     sync->current.pattern = (total_rows / 64) % 8;
     
-    int scene = (int)(sync->current.time / 12.0f) % 5;
-    float scene_progress = fmodf(sync->current.time, 12.0f) / 12.0f;
-    
-    sync->current.intensity = 0.5f + scene_progress * 0.5f;
+    timeline_query(sync->timeline, &sync->timeline_cursor, sync->current.time, &sync->scene);
+    int scene = sync->scene.scene;
+    sync->current.intensity = 0.5f + sync->scene.progress * 0.5f;
     
-    AudioSnapshot snapshot = {0};
-    if (audio) {
-        audio_get_snapshot(audio, &snapshot);
-    }
+    bool has_envelopes = audio && audio->envelopes.values;
+    sync->envelopes = has_envelopes ? &audio->envelopes : NULL;
+    // Envelopes are read at the locked time, which moves smoothly and is
+    // what is heard; the snapshot is a buffer ahead and steps per callback
+    float envelope_time = clocked ? sync->current.time : snapshot.time;
     
-    if (audio && (snapshot.bass_energy > 0.001f || snapshot.mid_energy > 0.001f || snapshot.high_energy > 0.001f)) {
+    if (has_envelopes) {
+        const AudioEnvelopeTracks* env = &audio->envelopes;
+        float t = envelope_time;
+        
+        sync->current.bass = audio_envelope_value(env, AUDIO_STEM_KICK, AUDIO_ENV_RMS, t);
+        sync->current.mid = audio_envelope_value(env, AUDIO_STEM_BASS, AUDIO_ENV_RMS, t);
+        sync->current.high = fmaxf(audio_envelope_value(env, AUDIO_STEM_LEAD, AUDIO_ENV_RMS, t),
+                                   audio_envelope_value(env, AUDIO_STEM_HIHAT, AUDIO_ENV_RMS, t));
+    } else if (audio && (snapshot.bass_energy > 0.001f || snapshot.mid_energy > 0.001f || snapshot.high_energy > 0.001f)) {
         float bass_scale = 8.0f;
         float mid_scale = 5.0f;
         float high_scale = 3.0f;
@@ -72,118 +692,200 @@ void sync_update(RocketSync* sync, AudioEngine* audio, float dt) {
         sync->current.high = (scene >= 3) ? 0.7f : 0.3f;
     }
     
+    // The row grid assumes this song's tempo, so it only backs up the
+    // audio triggers when no onset detector is attached
+    bool use_grid = !(sync->onsets && audio);
     int prev_row = sync->previous.row;
-    bool timing_kick = (sync->current.row % 4 == 0) && (prev_row % 4 != 0);
-    bool timing_snare = (sync->current.row % 8 == 4) && (prev_row % 8 != 4);
+    bool timing_kick = use_grid && (sync->current.row % 4 == 0) && (prev_row % 4 != 0);
+    bool timing_snare = use_grid && (sync->current.row % 8 == 4) && (prev_row % 8 != 4);
     
-    bool audio_kick = audio && (snapshot.bass_energy > 0.5f) && (snapshot.bass_energy > sync->previous.bass * 1.5f);
-    bool audio_snare = audio && (snapshot.mid_energy > 0.4f) && (snapshot.mid_energy > sync->previous.mid * 1.3f);
+    bool audio_kick = false;
+    bool audio_snare = false;
+    if (!use_grid) {
+        sync_drain_onsets(sync, audio, &audio_kick, &audio_snare);
+    } else if (has_envelopes) {
+        audio_kick = audio_envelope_value(&audio->envelopes, AUDIO_STEM_KICK, AUDIO_ENV_ONSET, envelope_time) > 0.5f;
+        audio_snare = audio_envelope_value(&audio->envelopes, AUDIO_STEM_SNARE, AUDIO_ENV_ONSET, envelope_time) > 0.5f;
+    } else {
+        audio_kick = audio && (snapshot.bass_energy > 0.5f) && (snapshot.bass_energy > sync->previous.bass * 1.5f);
+        audio_snare = audio && (snapshot.mid_energy > 0.4f) && (snapshot.mid_energy > sync->previous.mid * 1.3f);
+    }
     
+    if (timing_kick || timing_snare) {
+        uint32_t row_start = sync_sample_at(sync, (float)total_rows * row_duration);
+        sync->stamps[SYNC_TRIGGER_KICK] = row_start;
+        sync->stamps[SYNC_TRIGGER_SNARE] = row_start;
+        sync->stamped |= (timing_kick ? SYNC_TRIGGER_BIT(SYNC_TRIGGER_KICK) : 0) |
+                         (timing_snare ? SYNC_TRIGGER_BIT(SYNC_TRIGGER_SNARE) : 0);
+    }
     sync->current.kick = timing_kick || audio_kick;
     sync->current.snare = timing_snare || audio_snare;
     sync->current.hihat = (sync->current.row % 2 == 1);
     
-    if (sync->transition_active) {
-        sync->transition_time -= dt;
-        if (sync->transition_time <= 0.0f) {
-            sync->transition_active = false;
-            sync->transition_time = 0.0f;
-        }
-    }
+    sync_finish_update(sync, dt);
 }
 
-float sync_get_value(RocketSync* sync, const char* track_name) {
-    // Simple track value mapping based on common demoscene tracks
-    if (strcmp(track_name, "intensity") == 0) {
-        if (sync->transition_active) {
-            float t = 1.0f - (sync->transition_time / 2.0f);
-            return lerp(sync->previous.intensity, sync->current.intensity, t);
-        }
-        return sync->current.intensity;
-    }
-    
-    if (strcmp(track_name, "bass") == 0) {
-        if (sync->transition_active) {
-            float t = 1.0f - (sync->transition_time / 2.0f);
-            return lerp(sync->previous.bass, sync->current.bass, t);
-        }
-        return sync->current.bass;
-    }
+// Takes a frame recorded from an earlier sync_update() in place of the
+// live analysis, then refreshes every track as that update did
+void sync_update_replay(RocketSync* sync, const SyncData* data, bool tracked_beat, float dt) {
+    sync->previous = sync->current;
+    sync->current = *data;
+    sync->tracked_beat = tracked_beat;
+    timeline_query(sync->timeline, &sync->timeline_cursor, data->time, &sync->scene);
+    sync->stamped = 0;
+    sync->sample_pos = (uint32_t)(data->time * sync->sample_rate);
+    sync_finish_update(sync, dt);
+}
+
+// The slot holding name, or the empty slot that ends its probe chain
+static uint32_t sync_probe_name(const SyncTracks* tracks, const char* name) {
+    uint32_t slot = sync_hash_name(name) & (SYNC_HASH_SIZE - 1);
     
-    if (strcmp(track_name, "mid") == 0) {
-        if (sync->transition_active) {
-            float t = 1.0f - (sync->transition_time / 2.0f);
-            return lerp(sync->previous.mid, sync->current.mid, t);
+    while (tracks->slots[slot] != 0) {
+        int handle = tracks->slots[slot] - 1;
+        if (strncmp(tracks->names[handle], name, SYNC_TRACK_NAME - 1) == 0) {
+            break;
         }
-        return sync->current.mid;
+        slot = (slot + 1) & (SYNC_HASH_SIZE - 1);
     }
-    
-    if (strcmp(track_name, "high") == 0) {
-        if (sync->transition_active) {
-            float t = 1.0f - (sync->transition_time / 2.0f);
-            return lerp(sync->previous.high, sync->current.high, t);
-        }
-        return sync->current.high;
+    return slot;
+}
+
+// Handle of an already registered track, or -1
+int sync_find_track(const RocketSync* sync, const char* name) {
+    return sync->tracks.slots[sync_probe_name(&sync->tracks, name)] - 1;
+}
+
+// Interns name and returns its handle, registering it on first use. Names
+// outside the built-in set fall back to an expression picked by substring,
+// or read as 0. Returns -1 when the registry is full.
+int sync_track(RocketSync* sync, const char* name) {
+    SyncTracks* tracks = &sync->tracks;
+    uint32_t slot = sync_probe_name(tracks, name);
+    if (tracks->slots[slot] != 0) {
+        return tracks->slots[slot] - 1;
     }
     
-    if (strcmp(track_name, "beat") == 0) {
-        return fmodf(sync->current.beat, 1.0f);
+    if (tracks->count >= SYNC_MAX_TRACKS) {
+        fprintf(stderr, "WARNING: Sync track limit reached, ignoring '%s'\n", name);
+        return -1;
     }
     
-    if (strcmp(track_name, "bar") == 0) {
-        return (float)sync->current.bar;
+    // Names are matched on what is stored, so longer ones share a track
+    // with anything of the same prefix
+    if (strlen(name) > SYNC_TRACK_NAME - 1) {
+        fprintf(stderr, "WARNING: Sync track name '%s' cut to %d characters\n", name, SYNC_TRACK_NAME - 1);
     }
     
-    if (strcmp(track_name, "pattern") == 0) {
-        return (float)sync->current.pattern;
+    int handle = (int)tracks->count++;
+    if (handle == SYNC_UNIFORM_TRACKS) {
+        fprintf(stderr, "WARNING: Sync track '%s' and later ones are past the %d shader uniforms\n", name, SYNC_UNIFORM_TRACKS);
     }
+    strncpy(tracks->names[handle], name, SYNC_TRACK_NAME - 1);
+    tracks->names[handle][SYNC_TRACK_NAME - 1] = '\0';
+    tracks->value_kinds[handle] = SYNC_VALUE_NONE;
+    tracks->trigger_kinds[handle] = SYNC_TRIGGER_NONE;
+    sync_key_track_init(&tracks->keys[handle]);
+    sync_load_segment(tracks, (uint32_t)handle, 0.0f);
+    tracks->slots[slot] = (int16_t)(handle + 1);
     
-    if (strcmp(track_name, "time") == 0) {
-        return sync->current.time;
+    const char* expression = NULL;
+    bool builtin = false;
+    for (size_t i = 0; i < sizeof(sync_builtin_tracks) / sizeof(sync_builtin_tracks[0]); i++) {
+        if (strcmp(name, sync_builtin_tracks[i].name) == 0) {
+            expression = sync_builtin_tracks[i].expression;
+            tracks->trigger_kinds[handle] = sync_builtin_tracks[i].trigger;
+            builtin = true;
+            break;
+        }
     }
-    
-    // Default values for unknown tracks
-    if (strstr(track_name, "rotate") != NULL) {
-        return sync->current.time * 0.5f;
+    for (size_t i = 0; !builtin && i < sizeof(sync_fallback_tracks) / sizeof(sync_fallback_tracks[0]); i++) {
+        if (strstr(name, sync_fallback_tracks[i].pattern) != NULL) {
+            expression = sync_fallback_tracks[i].expression;
+            break;
+        }
     }
-    
-    if (strstr(track_name, "pulse") != NULL) {
-        return sinf(sync->current.time * 2.0f) * 0.5f + 0.5f;
+    if (expression && sync_expr_compile(&tracks->exprs[handle], expression, NULL, NULL) == 0) {
+        tracks->value_kinds[handle] = SYNC_VALUE_EXPR;
     }
     
-    if (strstr(track_name, "wave") != NULL) {
-        return sinf(sync->current.beat * 0.5f) * 0.5f + 0.5f;
+    if (sync->editor_connected) {
+        sync_editor_request_track(sync, handle);
     }
     
-    return 0.0f;
+    // Valid straight away rather than from the next update
+    sync_refresh_track(sync, handle);
+    return handle;
 }
 
-bool sync_get_trigger(RocketSync* sync, const char* trigger_name) {
-    if (strcmp(trigger_name, "kick") == 0) {
-        return sync->current.kick && !sync->previous.kick;
-    }
-    
-    if (strcmp(trigger_name, "snare") == 0) {
-        return sync->current.snare && !sync->previous.snare;
+static int sync_resolve_track(void* user, const char* name) {
+    return sync_track((RocketSync*)user, name);
+}
+
+// Defines name as an expression over the inputs and other tracks, which
+// are registered as they are named. Track references read the values of
+// the last update, so a track may refer to itself for feedback, which
+// steps once per update. Returns the handle, or -1 if the expression does
+// not compile.
+int sync_define(RocketSync* sync, const char* name, const char* expression) {
+    SyncExpr expr;
+    int handle = sync_track(sync, name);
+    if (handle < 0 || sync_expr_compile(&expr, expression, sync_resolve_track, sync) != 0) {
+        return -1;
     }
     
-    if (strcmp(trigger_name, "hihat") == 0) {
-        return sync->current.hihat && !sync->previous.hihat;
+    sync->tracks.exprs[handle] = expr;
+    sync->tracks.value_kinds[handle] = SYNC_VALUE_EXPR;
+    sync_refresh_track(sync, handle);
+    return handle;
+}
+
+// The first key turns a track into a keyframe track for good
+int sync_set_key(RocketSync* sync, int handle, uint32_t row, float value, SyncKeyType type) {
+    if (handle < 0 || (uint32_t)handle >= sync->tracks.count) {
+        return -1;
     }
-    
-    if (strcmp(trigger_name, "beat") == 0) {
-        return ((int)sync->current.beat != (int)sync->previous.beat);
+    if (sync_key_track_set(&sync->tracks.keys[handle], row, value, type) != 0) {
+        return -1;
     }
-    
-    if (strcmp(trigger_name, "bar") == 0) {
-        return (sync->current.bar != sync->previous.bar);
+    sync->tracks.value_kinds[handle] = SYNC_VALUE_KEYS;
+    sync_refresh_track(sync, handle);
+    return 0;
+}
+
+bool sync_delete_key(RocketSync* sync, int handle, uint32_t row) {
+    if (handle < 0 || (uint32_t)handle >= sync->tracks.count || !sync_key_track_delete(&sync->tracks.keys[handle], row)) {
+        return false;
     }
-    
-    if (strcmp(trigger_name, "pattern") == 0) {
-        return (sync->current.pattern != sync->previous.pattern);
+    sync_refresh_track(sync, handle);
+    return true;
+}
+
+// Points a track at keys owned by someone else, which must outlive it or
+// its first edit
+void sync_borrow_keys(RocketSync* sync, int handle, const uint32_t* rows, const float* values, const uint8_t* types, uint32_t count) {
+    if (handle < 0 || (uint32_t)handle >= sync->tracks.count) {
+        return;
     }
     
-    return false;
+    SyncKeyTrack* keys = &sync->tracks.keys[handle];
+    sync_key_track_free(keys);
+    keys->rows = (uint32_t*)rows;
+    keys->values = (float*)values;
+    keys->types = (uint8_t*)types;
+    keys->count = count;
+    sync->tracks.value_kinds[handle] = SYNC_VALUE_KEYS;
+    sync_refresh_track(sync, handle);
+}
+
+// String lookups for callers that have not cached a handle. They never
+// register a track; unknown names read as 0 / false.
+float sync_get_value(RocketSync* sync, const char* track_name) {
+    return sync_get_value_h(sync, sync_find_track(sync, track_name));
+}
+
+bool sync_get_trigger(RocketSync* sync, const char* trigger_name) {
+    return sync_get_trigger_h(sync, sync_find_track(sync, trigger_name));
 }
 
 void sync_set_transition(RocketSync* sync, float duration) {
@@ -2,7 +2,76 @@
 #define SYNC_SYSTEM_H
 
 #include "audio_synthesis.h"
+#include "audio_onset.h"
+#include "sync_tracks.h"
+#include "sync_expr.h"
+#include "platform.h"
+#include "timeline.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+#define SYNC_MAX_TRACKS 256
+#define SYNC_TRACK_NAME 32
+// Open-addressed, kept at most half full
+#define SYNC_HASH_SIZE 512
+// Keyframe rows, as in the editor's row grid
+#define SYNC_ROWS_PER_BEAT 4
+// Track values in the uniform block, as vec4 iTracks[SYNC_UNIFORM_TRACKS / 4].
+// Only handles below this reach the shader, and SYNC_BUILTIN_TRACKS of them
+// are the built-ins; later tracks can still be read on the CPU.
+#define SYNC_UNIFORM_TRACKS 32
+
+#define SYNC_EDITOR_PORT 1338
+#define SYNC_EDITOR_BUFFER 512
+// Longest the editor connection may hold up one sync_update()
+#define SYNC_EDITOR_BUDGET 0.001
+// Trigger edges kept per update, in bit order
+#define SYNC_MAX_EVENTS 32
+// Sample rate assumed for event timestamps until audio is attached
+#define SYNC_SAMPLE_RATE 44100.0f
+
+// Handles of the tracks sync_init() registers, in registration order
+enum {
+    SYNC_TRACK_INTENSITY,
+    SYNC_TRACK_BASS,
+    SYNC_TRACK_MID,
+    SYNC_TRACK_HIGH,
+    SYNC_TRACK_BEAT,
+    SYNC_TRACK_BAR,
+    SYNC_TRACK_PATTERN,
+    SYNC_TRACK_TIME,
+    SYNC_TRACK_KICK,
+    SYNC_TRACK_SNARE,
+    SYNC_TRACK_HIHAT,
+    SYNC_TRACK_TRACKED_BEAT,
+    SYNC_BUILTIN_TRACKS
+};
+
+// Bits of the trigger masks. Gates (kick, snare, hihat, tracked beat)
+// fire on their rising edge. Counters (beat, bar, pattern) fire whenever
+// their count changes, by any amount, and have no level. Bit 0 is never
+// set, so tracks without a trigger test it.
+typedef enum {
+    SYNC_TRIGGER_NONE,
+    SYNC_TRIGGER_KICK,
+    SYNC_TRIGGER_SNARE,
+    SYNC_TRIGGER_HIHAT,
+    SYNC_TRIGGER_BEAT,
+    SYNC_TRIGGER_TRACKED_BEAT,
+    SYNC_TRIGGER_BAR,
+    SYNC_TRIGGER_PATTERN,
+    SYNC_TRIGGER_COUNT
+} SyncTriggerKind;
+
+#define SYNC_TRIGGER_BIT(kind) ((uint64_t)1 << (kind))
+
+// One edge of one trigger, stamped with the analysis ring position
+// (AudioEngine.ring_write) at which it happened
+typedef struct {
+    uint32_t sample_pos;
+    uint8_t kind;
+    bool rising;
+} SyncEvent;
 
 typedef struct {
     float time;
@@ -19,17 +88,117 @@ typedef struct {
     bool hihat;
 } SyncData;
 
+// Named tracks interned into integer handles. A handle indexes the value
+// array, which sync_update() refreshes for every registered track, so
+// reading one is a single load; a trigger is one bit test on the mask. A
+// track is computed from a compiled expression or from keyframes, or reads
+// as 0.
+//
+// Every track is evaluated as a cubic over its current segment,
+// c0 + t * (c1 + t * (c2 + t * c3)) with t = (row - start) * scale clamped
+// to 0..1, so all of them go through one vectorized pass. Expressions
+// hold c0 only; keyframe segments are reloaded when the row leaves
+// [start, end).
+typedef struct {
+    char names[SYNC_MAX_TRACKS][SYNC_TRACK_NAME];
+    uint8_t value_kinds[SYNC_MAX_TRACKS];
+    uint8_t trigger_kinds[SYNC_MAX_TRACKS];
+    float values[SYNC_MAX_TRACKS];
+    SyncKeyTrack keys[SYNC_MAX_TRACKS];
+    SyncExpr exprs[SYNC_MAX_TRACKS];
+    float seg_start[SYNC_MAX_TRACKS];
+    float seg_end[SYNC_MAX_TRACKS];
+    float seg_scale[SYNC_MAX_TRACKS];
+    float seg_c0[SYNC_MAX_TRACKS];
+    float seg_c1[SYNC_MAX_TRACKS];
+    float seg_c2[SYNC_MAX_TRACKS];
+    float seg_c3[SYNC_MAX_TRACKS];
+    // Handle + 1 per slot, 0 when empty
+    int16_t slots[SYNC_HASH_SIZE];
+    uint32_t count;
+} SyncTracks;
+
+typedef struct SyncRecorder SyncRecorder;
+
 typedef struct {
     SyncData current;
     SyncData previous;
+    // Scene at the current sync time
+    const Timeline* timeline;
+    TimelineCursor timeline_cursor;
+    TimelinePoint scene;
     float transition_time;
     bool transition_active;
+    // Optional onset detector feed. When attached, kick and snare come from
+    // detected onsets instead of the song's row grid, and tracked_beat
+    // fires on the beat tracker's predicted beats.
+    OnsetQueue* onsets;
+    uint32_t next_beat_pos;
+    bool beat_pending;
+    bool tracked_beat;
+    float tempo;
+    // Every trigger as one bit: levels holds this update's gate states,
+    // fired and falling the edges since the last one. events lists the same
+    // edges with the sample each happened at; sources that know it exactly
+    // (the onset detector) leave it in stamps and flag it in stamped.
+    uint64_t levels;
+    uint64_t fired;
+    uint64_t falling;
+    uint64_t stamped;
+    uint32_t stamps[SYNC_TRIGGER_COUNT];
+    SyncEvent events[SYNC_MAX_EVENTS];
+    uint32_t event_count;
+    uint32_t sample_pos;
+    float sample_rate;
+    // Precalculated audio envelopes seen by the last update, for
+    // evaluating frames other than the current one
+    const AudioEnvelopeTracks* envelopes;
+    SyncTracks tracks;
+    // Connection to a GNU Rocket editor. Tracks are requested in handle
+    // order, so the editor's track indices are our handles. While paused
+    // the editor drives the row and sync time stands still.
+    PlatformSocket editor;
+    bool editor_connected;
+    bool editor_paused;
+    int editor_row;
+    uint8_t editor_buffer[SYNC_EDITOR_BUFFER];
+    uint32_t editor_fill;
+    // Exported tracks loaded from disk; keyframe tracks borrow from it
+    FileMapping export_mapping;
+    // Set while frames are being recorded or replayed
+    SyncRecorder* recorder;
 } RocketSync;
 
 void sync_init(RocketSync* sync);
+void sync_cleanup(RocketSync* sync);
+void sync_attach_onsets(RocketSync* sync, OnsetQueue* onsets);
+int sync_editor_connect(RocketSync* sync, const char* host, uint16_t port);
+void sync_editor_disconnect(RocketSync* sync);
 void sync_update(RocketSync* sync, AudioEngine* audio, float dt);
+void sync_update_replay(RocketSync* sync, const SyncData* data, bool tracked_beat, float dt);
+void sync_eval_batch(RocketSync* sync, float time, float* out, uint32_t count);
+void sync_eval_frames(RocketSync* sync, int handle, float start, float step, float* out, uint32_t count);
+int sync_track(RocketSync* sync, const char* name);
+int sync_find_track(const RocketSync* sync, const char* name);
+int sync_define(RocketSync* sync, const char* name, const char* expression);
+int sync_set_key(RocketSync* sync, int handle, uint32_t row, float value, SyncKeyType type);
+bool sync_delete_key(RocketSync* sync, int handle, uint32_t row);
+void sync_borrow_keys(RocketSync* sync, int handle, const uint32_t* rows, const float* values, const uint8_t* types, uint32_t count);
 float sync_get_value(RocketSync* sync, const char* track_name);
 bool sync_get_trigger(RocketSync* sync, const char* trigger_name);
 void sync_set_transition(RocketSync* sync, float duration);
 
+// Handles come from sync_track(); -1 reads as 0 / false
+static inline float sync_get_value_h(const RocketSync* sync, int handle) {
+    return (handle >= 0) ? sync->tracks.values[handle] : 0.0f;
+}
+
+static inline bool sync_get_trigger_h(const RocketSync* sync, int handle) {
+    return (handle >= 0) && (sync->fired & SYNC_TRIGGER_BIT(sync->tracks.trigger_kinds[handle]));
+}
+
+static inline bool sync_trigger(const RocketSync* sync, SyncTriggerKind kind) {
+    return (sync->fired & SYNC_TRIGGER_BIT(kind)) != 0;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "sync_tracks.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void sync_key_track_init(SyncKeyTrack* track) {
+    memset(track, 0, sizeof(*track));
+}
+
+void sync_key_track_free(SyncKeyTrack* track) {
+    if (track->capacity) {
+        free(track->rows);
+        free(track->values);
+        free(track->types);
+    }
+    sync_key_track_init(track);
+}
+
+// Index of the last key at or before row, or 0 when row precedes them all
+uint32_t sync_key_track_seek(const SyncKeyTrack* track, float row) {
+    uint32_t low = 0;
+    uint32_t high = track->count;
+    
+    while (high - low > 1) {
+        uint32_t mid = (low + high) / 2;
+        if ((float)track->rows[mid] <= row) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// First key at or after row
+static uint32_t sync_key_lower_bound(const SyncKeyTrack* track, uint32_t row) {
+    uint32_t low = 0;
+    uint32_t high = track->count;
+    
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (track->rows[mid] < row) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static int sync_key_track_grow(SyncKeyTrack* track) {
+    uint32_t capacity = track->capacity ? track->capacity * 2 : 16;
+    uint32_t* rows = realloc(track->rows, capacity * sizeof(uint32_t));
+    if (rows) track->rows = rows;
+    float* values = realloc(track->values, capacity * sizeof(float));
+    if (values) track->values = values;
+    uint8_t* types = realloc(track->types, capacity * sizeof(uint8_t));
+    if (types) track->types = types;
+    
+    if (!rows || !values || !types) {
+        fprintf(stderr, "Failed to grow sync track to %u keys\n", capacity);
+        return -1;
+    }
+    track->capacity = capacity;
+    return 0;
+}
+
+// Copies borrowed keys into arrays of the track's own, before an edit or
+// before the memory they borrow goes away
+int sync_key_track_own(SyncKeyTrack* track) {
+    SyncKeyTrack borrowed = *track;
+    
+    // An empty borrowed track has nothing to copy, only pointers to drop
+    sync_key_track_init(track);
+    if (borrowed.count == 0) {
+        return 0;
+    }
+    while (track->capacity < borrowed.count) {
+        if (sync_key_track_grow(track) != 0) {
+            sync_key_track_free(track);
+            *track = borrowed;
+            return -1;
+        }
+    }
+    memcpy(track->rows, borrowed.rows, borrowed.count * sizeof(uint32_t));
+    memcpy(track->values, borrowed.values, borrowed.count * sizeof(float));
+    memcpy(track->types, borrowed.types, borrowed.count * sizeof(uint8_t));
+    track->count = borrowed.count;
+    return 0;
+}
+
+// Adds a key, or replaces the one already on that row
+int sync_key_track_set(SyncKeyTrack* track, uint32_t row, float value, SyncKeyType type) {
+    if (track->capacity == 0 && track->rows && sync_key_track_own(track) != 0) {
+        return -1;
+    }
+    
+    uint32_t index = sync_key_lower_bound(track, row);
+    if (index == track->count || track->rows[index] != row) {
+        if (track->count == track->capacity && sync_key_track_grow(track) != 0) {
+            return -1;
+        }
+        uint32_t tail = track->count - index;
+        memmove(track->rows + index + 1, track->rows + index, tail * sizeof(uint32_t));
+        memmove(track->values + index + 1, track->values + index, tail * sizeof(float));
+        memmove(track->types + index + 1, track->types + index, tail * sizeof(uint8_t));
+        track->count++;
+    }
+    
+    track->rows[index] = row;
+    track->values[index] = value;
+    track->types[index] = (uint8_t)type;
+    track->cursor = 0;
+    return 0;
+}
+
+bool sync_key_track_delete(SyncKeyTrack* track, uint32_t row) {
+    uint32_t index = sync_key_lower_bound(track, row);
+    if (index == track->count || track->rows[index] != row) {
+        return false;
+    }
+    if (track->capacity == 0 && sync_key_track_own(track) != 0) {
+        return false;
+    }
+    
+    uint32_t tail = track->count - index - 1;
+    memmove(track->rows + index, track->rows + index + 1, tail * sizeof(uint32_t));
+    memmove(track->values + index, track->values + index + 1, tail * sizeof(float));
+    memmove(track->types + index, track->types + index + 1, tail * sizeof(uint8_t));
+    track->count--;
+    track->cursor = 0;
+    return true;
+}
+
+float sync_key_track_eval(SyncKeyTrack* track, float row) {
+    uint32_t count = track->count;
+    if (count == 0) {
+        return 0.0f;
+    }
+    
+    // Still inside the cursor's span, or one key further on, covers every
+    // frame of normal playback
+    uint32_t k = track->cursor;
+    if ((float)track->rows[k] > row) {
+        k = sync_key_track_seek(track, row);
+    } else if (k + 1 < count && (float)track->rows[k + 1] <= row) {
+        k++;
+        if (k + 1 < count && (float)track->rows[k + 1] <= row) {
+            k = sync_key_track_seek(track, row);
+        }
+    }
+    track->cursor = k;
+    
+    float a = track->values[k];
+    if (k + 1 == count || row <= (float)track->rows[k]) {
+        return a;
+    }
+    
+    float b = track->values[k + 1];
+    float t = (row - (float)track->rows[k]) / (float)(track->rows[k + 1] - track->rows[k]);
+    switch (track->types[k]) {
+        case SYNC_KEY_STEP:
+            return a;
+        case SYNC_KEY_LINEAR:
+            return a + (b - a) * t;
+        case SYNC_KEY_SMOOTH:
+            return a + (b - a) * t * t * (3.0f - 2.0f * t);
+        case SYNC_KEY_RAMP:
+            return a + (b - a) * t * t;
+    }
+    return a;
+}
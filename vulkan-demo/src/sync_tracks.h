@@ -0,0 +1,37 @@
+#ifndef SYNC_TRACKS_H
+#define SYNC_TRACKS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Interpolation from a key to the next one, as in GNU Rocket
+typedef enum {
+    SYNC_KEY_STEP,
+    SYNC_KEY_LINEAR,
+    SYNC_KEY_SMOOTH,
+    SYNC_KEY_RAMP
+} SyncKeyType;
+
+// Keyframes sorted by row, stored as parallel arrays. The cursor remembers
+// the key used by the last evaluation, so playing forward only ever checks
+// the next key; jumps fall back to a binary search. Tracks with capacity 0
+// borrow their arrays, e.g. from a mapped export, and copy them on first
+// edit.
+typedef struct {
+    uint32_t* rows;
+    float* values;
+    uint8_t* types;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t cursor;
+} SyncKeyTrack;
+
+void sync_key_track_init(SyncKeyTrack* track);
+void sync_key_track_free(SyncKeyTrack* track);
+int sync_key_track_own(SyncKeyTrack* track);
+int sync_key_track_set(SyncKeyTrack* track, uint32_t row, float value, SyncKeyType type);
+bool sync_key_track_delete(SyncKeyTrack* track, uint32_t row);
+uint32_t sync_key_track_seek(const SyncKeyTrack* track, float row);
+float sync_key_track_eval(SyncKeyTrack* track, float row);
+
+#endif
@@ -0,0 +1,85 @@
+#include "timeline.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Intro, groove, lead, build, finale
+static const TimelineScene demo_scenes[] = {
+    {12.0f, 1.0f, 1.0f, TIMELINE_CURVE_LINEAR, 1.0f},
+    {12.0f, 1.0f, 1.0f, TIMELINE_CURVE_LINEAR, 1.0f},
+    {12.0f, 1.0f, 1.0f, TIMELINE_CURVE_LINEAR, 1.0f},
+    {12.0f, 1.0f, 1.0f, TIMELINE_CURVE_LINEAR, 1.0f},
+    {12.0f, 1.0f, 1.0f, TIMELINE_CURVE_LINEAR, 1.0f}
+};
+
+int timeline_init(Timeline* timeline, const TimelineScene* scenes, uint32_t count) {
+    memset(timeline, 0, sizeof(*timeline));
+    if (count == 0 || count > TIMELINE_MAX_SCENES) {
+        fprintf(stderr, "ERROR: Timeline needs 1 to %d scenes, got %u\n", TIMELINE_MAX_SCENES, count);
+        return -1;
+    }
+    
+    float start = 0.0f;
+    for (uint32_t i = 0; i < count; i++) {
+        if (scenes[i].duration <= 0.0f) {
+            fprintf(stderr, "ERROR: Timeline scene %u has no duration\n", i);
+            return -1;
+        }
+        timeline->scenes[i] = scenes[i];
+        timeline->starts[i] = start;
+        start += scenes[i].duration;
+    }
+    timeline->starts[count] = start;
+    timeline->count = count;
+    timeline->length = start;
+    return 0;
+}
+
+// Built on first use, which is audio_init() on the main thread
+const Timeline* timeline_demo(void) {
+    static Timeline timeline;
+    static bool built = false;
+    if (!built) {
+        timeline_init(&timeline, demo_scenes, sizeof(demo_scenes) / sizeof(demo_scenes[0]));
+        built = true;
+    }
+    return &timeline;
+}
+
+void timeline_query(const Timeline* timeline, TimelineCursor* cursor, float time, TimelinePoint* point) {
+    float t = time - cursor->loop_start;
+    
+    // Rewound, or on into the next pass through the table
+    if (t < 0.0f || t >= timeline->length) {
+        cursor->loop_start = floorf(time / timeline->length) * timeline->length;
+        t = fminf(fmaxf(time - cursor->loop_start, 0.0f), timeline->length);
+    }
+    
+    uint32_t s = cursor->scene;
+    while (s + 1 < timeline->count && t >= timeline->starts[s + 1]) {
+        s++;
+    }
+    while (s > 0 && t < timeline->starts[s]) {
+        s--;
+    }
+    cursor->scene = s;
+    
+    const TimelineScene* scene = &timeline->scenes[s];
+    float elapsed = t - timeline->starts[s];
+    float remaining = scene->duration - elapsed;
+    float fade = 1.0f;
+    if (elapsed < scene->fade_in) {
+        fade = elapsed / scene->fade_in;
+    }
+    if (remaining < scene->fade_out) {
+        fade = fminf(fade, remaining / scene->fade_out);
+    }
+    if (scene->curve == TIMELINE_CURVE_SMOOTH) {
+        fade = fade * fade * (3.0f - 2.0f * fade);
+    }
+    
+    point->scene = (int)s;
+    point->local = elapsed * scene->warp;
+    point->progress = elapsed / scene->duration;
+    point->transition = fade;
+}
@@ -0,0 +1,58 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TIMELINE_MAX_SCENES 32
+
+// Shape of a scene's fade in and out
+typedef enum {
+    TIMELINE_CURVE_LINEAR,
+    TIMELINE_CURVE_SMOOTH
+} TimelineCurve;
+
+// One scene: how long it runs, how long it takes to fade in and out (0 is
+// a hard cut), and how fast its local clock runs against song time.
+// Fields are all 4 bytes so the table hashes without padding.
+typedef struct {
+    float duration;
+    float fade_in;
+    float fade_out;
+    uint32_t curve;
+    float warp;
+} TimelineScene;
+
+// Scenes back to back from song time 0, looping after length.
+// starts[count] is the length.
+typedef struct {
+    TimelineScene scenes[TIMELINE_MAX_SCENES];
+    float starts[TIMELINE_MAX_SCENES + 1];
+    uint32_t count;
+    float length;
+} Timeline;
+
+// Where a song time falls in the timeline
+typedef struct {
+    int scene;
+    // Warped seconds since the scene started
+    float local;
+    // 0..1 through the scene, in song time
+    float progress;
+    // 0 at a cut, rising to 1 over the fade in and back over the fade out
+    float transition;
+} TimelinePoint;
+
+// The scene of the last query and the song time its loop pass started at.
+// Playing forward only ever checks the next scene; a division is needed
+// only when the time leaves the current pass. Zeroed is a valid cursor.
+typedef struct {
+    uint32_t scene;
+    float loop_start;
+} TimelineCursor;
+
+int timeline_init(Timeline* timeline, const TimelineScene* scenes, uint32_t count);
+const Timeline* timeline_demo(void);
+void timeline_query(const Timeline* timeline, TimelineCursor* cursor, float time, TimelinePoint* point);
+
+#endif
@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
     VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -172,6 +173,12 @@ void initVulkan(DemoApp* app) {
     createRenderPass(app);
     printf("  - Creating descriptor set layout...\n"); fflush(stdout);
     createDescriptorSetLayout(app);
+    // Everything ahead of the track values fits the guaranteed push
+    // constant space
+    const char* uniforms = getenv("DEMO_UNIFORMS");
+    app->pushConstants = uniforms && strcmp(uniforms, "push") == 0;
+    app->pushConstantSize = (uint32_t)offsetof(ShaderToyUniforms, iTracks);
+    printf("  - Uniform delivery: %s\n", app->pushConstants ? "push constants" : "uniform buffer"); fflush(stdout);
     printf("  - Creating graphics pipeline...\n"); fflush(stdout);
     createGraphicsPipeline(app);
     printf("  - Creating framebuffers...\n"); fflush(stdout);
@@ -182,6 +189,8 @@ void initVulkan(DemoApp* app) {
     createVertexBuffer(app);
     printf("  - Creating uniform buffer...\n"); fflush(stdout);
     createUniformBuffer(app);
+    printf("  - Creating audio texture...\n"); fflush(stdout);
+    createAudioTexture(app);
     printf("  - Creating descriptor pool...\n"); fflush(stdout);
     createDescriptorPool(app);
     printf("  - Creating descriptor sets...\n"); fflush(stdout);
@@ -196,12 +205,25 @@ void initVulkan(DemoApp* app) {
 void cleanupVulkan(DemoApp* app) {
     cleanupSwapChain(app);
     
+    vkDestroyPipeline(app->device, app->graphicsPipeline, NULL);
+    vkDestroyPipelineLayout(app->device, app->pipelineLayout, NULL);
+    vkDestroyRenderPass(app->device, app->renderPass, NULL);
+    
     vkDestroyDescriptorPool(app->device, app->descriptorPool, NULL);
     vkDestroyDescriptorSetLayout(app->device, app->descriptorSetLayout, NULL);
     
+    vkUnmapMemory(app->device, app->uniformBufferMemory);
     vkDestroyBuffer(app->device, app->uniformBuffer, NULL);
     vkFreeMemory(app->device, app->uniformBufferMemory, NULL);
     
+    vkDestroySampler(app->device, app->audioSampler, NULL);
+    vkDestroyImageView(app->device, app->audioImageView, NULL);
+    vkDestroyImage(app->device, app->audioImage, NULL);
+    vkFreeMemory(app->device, app->audioImageMemory, NULL);
+    vkUnmapMemory(app->device, app->audioStagingMemory);
+    vkDestroyBuffer(app->device, app->audioStagingBuffer, NULL);
+    vkFreeMemory(app->device, app->audioStagingMemory, NULL);
+    
     vkDestroyBuffer(app->device, app->vertexBuffer, NULL);
     vkFreeMemory(app->device, app->vertexBufferMemory, NULL);
     
@@ -567,15 +589,24 @@ void createRenderPass(DemoApp* app) {
 void createDescriptorSetLayout(DemoApp* app) {
     VkDescriptorSetLayoutBinding uboLayoutBinding = {0};
     uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
     uboLayoutBinding.pImmutableSamplers = NULL;
     
+    VkDescriptorSetLayoutBinding samplerLayoutBinding = {0};
+    samplerLayoutBinding.binding = 1;
+    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    samplerLayoutBinding.descriptorCount = 1;
+    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    samplerLayoutBinding.pImmutableSamplers = NULL;
+    
+    VkDescriptorSetLayoutBinding bindings[] = {uboLayoutBinding, samplerLayoutBinding};
+    
     VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
     
     if (vkCreateDescriptorSetLayout(app->device, &layoutInfo, NULL, &app->descriptorSetLayout) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create descriptor set layout!\n");
@@ -610,6 +641,20 @@ void createGraphicsPipeline(DemoApp* app) {
     fragShaderStageInfo.module = fragShaderModule;
     fragShaderStageInfo.pName = "main";
     
+    // Constant 0 selects where the shader reads the per-frame header from
+    VkBool32 usePushConstants = app->pushConstants ? VK_TRUE : VK_FALSE;
+    VkSpecializationMapEntry specEntry = {0};
+    specEntry.constantID = 0;
+    specEntry.offset = 0;
+    specEntry.size = sizeof(VkBool32);
+    
+    VkSpecializationInfo specInfo = {0};
+    specInfo.mapEntryCount = 1;
+    specInfo.pMapEntries = &specEntry;
+    specInfo.dataSize = sizeof(VkBool32);
+    specInfo.pData = &usePushConstants;
+    fragShaderStageInfo.pSpecializationInfo = &specInfo;
+    
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
     
     VkPipelineVertexInputStateCreateInfo vertexInputInfo = {0};
@@ -622,25 +667,18 @@ void createGraphicsPipeline(DemoApp* app) {
     inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
     
-    VkViewport viewport = {0};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)app->swapChainExtent.width;
-    viewport.height = (float)app->swapChainExtent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    
-    VkRect2D scissor = {0};
-    scissor.offset.x = 0;
-    scissor.offset.y = 0;
-    scissor.extent = app->swapChainExtent;
-    
+    // Viewport and scissor are set when recording, so the pipeline does
+    // not depend on the swap chain extent and survives a resize
     VkPipelineViewportStateCreateInfo viewportState = {0};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+    
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState = {0};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
     
     VkPipelineRasterizationStateCreateInfo rasterizer = {0};
     rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -672,6 +710,14 @@ void createGraphicsPipeline(DemoApp* app) {
     pipelineLayoutInfo.setLayoutCount = 1;
     pipelineLayoutInfo.pSetLayouts = &app->descriptorSetLayout;
     
+    // Declared in both modes, since the shader has the block either way
+    VkPushConstantRange pushConstantRange = {0};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = app->pushConstantSize;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    
     if (vkCreatePipelineLayout(app->device, &pipelineLayoutInfo, NULL, &app->pipelineLayout) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create pipeline layout!\n");
         exit(EXIT_FAILURE);
@@ -687,6 +733,7 @@ void createGraphicsPipeline(DemoApp* app) {
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
     pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = app->pipelineLayout;
     pipelineInfo.renderPass = app->renderPass;
     pipelineInfo.subpass = 0;
@@ -785,12 +832,35 @@ void createVertexBuffer(DemoApp* app) {
     vkUnmapMemory(app->device, app->vertexBufferMemory);
 }
 
+static uint32_t findMemoryType(DemoApp* app, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(app->physicalDevice, &memProperties);
+    
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1u << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    
+    fprintf(stderr, "Failed to find suitable memory type!\n");
+    exit(EXIT_FAILURE);
+}
+
 void createUniformBuffer(DemoApp* app) {
-    VkDeviceSize bufferSize = 128;
+    // One slot per frame in flight in a single buffer, persistently mapped
+    // and picked by dynamic offset. A slot is only rewritten after that
+    // frame's fence has signalled.
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(app->physicalDevice, &properties);
+    VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+    if (alignment == 0) {
+        alignment = 1;
+    }
+    app->uniformStride = (sizeof(ShaderToyUniforms) + alignment - 1) / alignment * alignment;
     
     VkBufferCreateInfo bufferInfo = {0};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = bufferSize;
+    bufferInfo.size = app->uniformStride * MAX_FRAMES_IN_FLIGHT;
     bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     
@@ -805,37 +875,208 @@ void createUniformBuffer(DemoApp* app) {
     VkMemoryAllocateInfo allocInfo = {0};
     allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
     allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(app, memRequirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(app->physicalDevice, &memProperties);
+    if (vkAllocateMemory(app->device, &allocInfo, NULL, &app->uniformBufferMemory) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate uniform buffer memory!\n");
+        exit(EXIT_FAILURE);
+    }
     
-    uint32_t memoryTypeIndex;
-    for (memoryTypeIndex = 0; memoryTypeIndex < memProperties.memoryTypeCount; memoryTypeIndex++) {
-        if ((memProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
-            (memProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
-            break;
-        }
+    vkBindBufferMemory(app->device, app->uniformBuffer, app->uniformBufferMemory, 0);
+    vkMapMemory(app->device, app->uniformBufferMemory, 0, bufferInfo.size, 0, &app->uniformBufferMapped);
+    memset(app->uniformBufferMapped, 0, (size_t)bufferInfo.size);
+}
+
+static void recordAudioUpload(DemoApp* app, VkCommandBuffer commandBuffer, VkDeviceSize stagingOffset) {
+    VkCommandBufferBeginInfo beginInfo = {0};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to begin recording audio upload command buffer!\n");
+        exit(EXIT_FAILURE);
     }
     
-    allocInfo.memoryTypeIndex = memoryTypeIndex;
+    // The previous frame may still be sampling the texture; the barrier
+    // waits for its fragment shader before the copy overwrites it
+    VkImageMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = app->audioImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, NULL, 0, NULL, 1, &barrier);
+    
+    VkBufferImageCopy region = {0};
+    region.bufferOffset = stagingOffset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent.width = AUDIO_TEXTURE_WIDTH;
+    region.imageExtent.height = AUDIO_TEXTURE_HEIGHT;
+    region.imageExtent.depth = 1;
+    
+    vkCmdCopyBufferToImage(commandBuffer, app->audioStagingBuffer, app->audioImage,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, NULL, 0, NULL, 1, &barrier);
+    
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to record audio upload command buffer!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void createAudioTexture(DemoApp* app) {
+    // One staging slot per frame in flight, persistently mapped. A slot is
+    // only rewritten after that frame's fence has signalled.
+    VkBufferCreateInfo bufferInfo = {0};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = AUDIO_TEXTURE_SIZE * MAX_FRAMES_IN_FLIGHT;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     
-    if (vkAllocateMemory(app->device, &allocInfo, NULL, &app->uniformBufferMemory) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to allocate uniform buffer memory!\n");
+    if (vkCreateBuffer(app->device, &bufferInfo, NULL, &app->audioStagingBuffer) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create audio staging buffer!\n");
         exit(EXIT_FAILURE);
     }
     
-    vkBindBufferMemory(app->device, app->uniformBuffer, app->uniformBufferMemory, 0);
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(app->device, app->audioStagingBuffer, &memRequirements);
+    
+    VkMemoryAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(app, memRequirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    
+    if (vkAllocateMemory(app->device, &allocInfo, NULL, &app->audioStagingMemory) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate audio staging memory!\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    vkBindBufferMemory(app->device, app->audioStagingBuffer, app->audioStagingMemory, 0);
+    vkMapMemory(app->device, app->audioStagingMemory, 0, bufferInfo.size, 0, &app->audioStagingMapped);
+    memset(app->audioStagingMapped, 0, (size_t)bufferInfo.size);
+    
+    VkImageCreateInfo imageInfo = {0};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8_UNORM;
+    imageInfo.extent.width = AUDIO_TEXTURE_WIDTH;
+    imageInfo.extent.height = AUDIO_TEXTURE_HEIGHT;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    
+    if (vkCreateImage(app->device, &imageInfo, NULL, &app->audioImage) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create audio texture!\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    vkGetImageMemoryRequirements(app->device, app->audioImage, &memRequirements);
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(app, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    
+    if (vkAllocateMemory(app->device, &allocInfo, NULL, &app->audioImageMemory) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate audio texture memory!\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    vkBindImageMemory(app->device, app->audioImage, app->audioImageMemory, 0);
+    
+    VkImageViewCreateInfo viewInfo = {0};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = app->audioImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R8_UNORM;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    
+    if (vkCreateImageView(app->device, &viewInfo, NULL, &app->audioImageView) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create audio texture view!\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    VkSamplerCreateInfo samplerInfo = {0};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 0.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    
+    if (vkCreateSampler(app->device, &samplerInfo, NULL, &app->audioSampler) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create audio texture sampler!\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    // The upload never changes shape, so each frame slot gets a command
+    // buffer recorded once and resubmitted alongside the draw
+    VkCommandBufferAllocateInfo cmdAllocInfo = {0};
+    cmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdAllocInfo.commandPool = app->commandPool;
+    cmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdAllocInfo.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+    
+    if (vkAllocateCommandBuffers(app->device, &cmdAllocInfo, app->audioUploadCommandBuffers) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate audio upload command buffers!\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        recordAudioUpload(app, app->audioUploadCommandBuffers[i], (VkDeviceSize)i * AUDIO_TEXTURE_SIZE);
+    }
 }
 
 void createDescriptorPool(DemoApp* app) {
-    VkDescriptorPoolSize poolSize = {0};
-    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = 1;
+    VkDescriptorPoolSize poolSizes[2] = {0};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = 1;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = 1;
     
     VkDescriptorPoolCreateInfo poolInfo = {0};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
     poolInfo.maxSets = 1;
     
     if (vkCreateDescriptorPool(app->device, &poolInfo, NULL, &app->descriptorPool) != VK_SUCCESS) {
@@ -861,31 +1102,102 @@ void createDescriptorSets(DemoApp* app) {
     VkDescriptorBufferInfo bufferInfo = {0};
     bufferInfo.buffer = app->uniformBuffer;
     bufferInfo.offset = 0;
-    bufferInfo.range = 128;
-    
-    VkWriteDescriptorSet descriptorWrite = {0};
-    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrite.dstSet = app->descriptorSet;
-    descriptorWrite.dstBinding = 0;
-    descriptorWrite.dstArrayElement = 0;
-    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    descriptorWrite.descriptorCount = 1;
-    descriptorWrite.pBufferInfo = &bufferInfo;
-    
-    vkUpdateDescriptorSets(app->device, 1, &descriptorWrite, 0, NULL);
+    bufferInfo.range = sizeof(ShaderToyUniforms);
+    
+    VkDescriptorImageInfo imageInfo = {0};
+    imageInfo.sampler = app->audioSampler;
+    imageInfo.imageView = app->audioImageView;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    
+    VkWriteDescriptorSet descriptorWrites[2] = {0};
+    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[0].dstSet = app->descriptorSet;
+    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].dstArrayElement = 0;
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrites[0].descriptorCount = 1;
+    descriptorWrites[0].pBufferInfo = &bufferInfo;
+    
+    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[1].dstSet = app->descriptorSet;
+    descriptorWrites[1].dstBinding = 1;
+    descriptorWrites[1].dstArrayElement = 0;
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[1].descriptorCount = 1;
+    descriptorWrites[1].pImageInfo = &imageInfo;
+    
+    vkUpdateDescriptorSets(app->device, 2, descriptorWrites, 0, NULL);
+}
+
+static void recordDrawCommands(DemoApp* app, VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t frameSlot) {
+    VkCommandBufferBeginInfo beginInfo = {0};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = app->pushConstants ? VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT : 0;
+    
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to begin recording command buffer!\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    VkRenderPassBeginInfo renderPassInfo = {0};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = app->renderPass;
+    renderPassInfo.framebuffer = app->swapChainFramebuffers[imageIndex];
+    renderPassInfo.renderArea.offset.x = 0;
+    renderPassInfo.renderArea.offset.y = 0;
+    renderPassInfo.renderArea.extent = app->swapChainExtent;
+    
+    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+    renderPassInfo.clearValueCount = 1;
+    renderPassInfo.pClearValues = &clearColor;
+    
+    VkViewport viewport = {0};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)app->swapChainExtent.width;
+    viewport.height = (float)app->swapChainExtent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    
+    VkRect2D scissor = {0};
+    scissor.offset.x = 0;
+    scissor.offset.y = 0;
+    scissor.extent = app->swapChainExtent;
+    
+    uint32_t uniformOffset = (uint32_t)(frameSlot * app->uniformStride);
+    
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app->graphicsPipeline);
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app->pipelineLayout, 0, 1, &app->descriptorSet, 1, &uniformOffset);
+    if (app->pushConstants) {
+        vkCmdPushConstants(commandBuffer, app->pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, app->pushConstantSize, app->pushConstantData);
+    }
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    vkCmdEndRenderPass(commandBuffer);
+    
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to record command buffer!\n");
+        exit(EXIT_FAILURE);
+    }
 }
 
+// The uniform slot is baked into each command buffer through its dynamic
+// offset, so there is one per swapchain image and frame slot, at
+// [image * MAX_FRAMES_IN_FLIGHT + slot]
 void createCommandBuffers(DemoApp* app) {
     uint32_t swapChainImageCount;
     vkGetSwapchainImagesKHR(app->device, app->swapChain, &swapChainImageCount, NULL);
+    uint32_t count = swapChainImageCount * MAX_FRAMES_IN_FLIGHT;
     
-    app->commandBuffers = malloc(swapChainImageCount * sizeof(VkCommandBuffer));
+    app->commandBuffers = malloc(count * sizeof(VkCommandBuffer));
     
     VkCommandBufferAllocateInfo allocInfo = {0};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.commandPool = app->commandPool;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = swapChainImageCount;
+    allocInfo.commandBufferCount = count;
     
     if (vkAllocateCommandBuffers(app->device, &allocInfo, app->commandBuffers) != VK_SUCCESS) {
         fprintf(stderr, "Failed to allocate command buffers!\n");
@@ -893,35 +1205,8 @@ void createCommandBuffers(DemoApp* app) {
     }
     
     for (uint32_t i = 0; i < swapChainImageCount; i++) {
-        VkCommandBufferBeginInfo beginInfo = {0};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        
-        if (vkBeginCommandBuffer(app->commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to begin recording command buffer!\n");
-            exit(EXIT_FAILURE);
-        }
-        
-        VkRenderPassBeginInfo renderPassInfo = {0};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = app->renderPass;
-        renderPassInfo.framebuffer = app->swapChainFramebuffers[i];
-        renderPassInfo.renderArea.offset.x = 0;
-        renderPassInfo.renderArea.offset.y = 0;
-        renderPassInfo.renderArea.extent = app->swapChainExtent;
-        
-        VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
-        
-        vkCmdBeginRenderPass(app->commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(app->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, app->graphicsPipeline);
-        vkCmdBindDescriptorSets(app->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, app->pipelineLayout, 0, 1, &app->descriptorSet, 0, NULL);
-        vkCmdDraw(app->commandBuffers[i], 3, 1, 0, 0);
-        vkCmdEndRenderPass(app->commandBuffers[i]);
-        
-        if (vkEndCommandBuffer(app->commandBuffers[i]) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to record command buffer!\n");
-            exit(EXIT_FAILURE);
+        for (uint32_t slot = 0; slot < MAX_FRAMES_IN_FLIGHT; slot++) {
+            recordDrawCommands(app, app->commandBuffers[i * MAX_FRAMES_IN_FLIGHT + slot], i, slot);
         }
     }
 }
@@ -997,6 +1282,14 @@ void drawFrame(DemoApp* app, float currentTime, int frame, void* audio, void* sy
     }
     
     updateUniforms(app, currentTime, frame, (AudioEngine*)audio, (RocketSync*)sync);
+    updateAudioTexture(app, (AudioEngine*)audio);
+    
+    // Push constants live in the command buffer, so this frame's has to be
+    // recorded again; its fence has signalled, so it is not in use
+    VkCommandBuffer drawBuffer = app->commandBuffers[imageIndex * MAX_FRAMES_IN_FLIGHT + app->currentFrame];
+    if (app->pushConstants) {
+        recordDrawCommands(app, drawBuffer, imageIndex, app->currentFrame);
+    }
     
     if (frame % 300 == 0) {
         printf("Uniforms updated successfully (frame %d)\n", frame);
@@ -1012,8 +1305,9 @@ void drawFrame(DemoApp* app, float currentTime, int frame, void* audio, void* sy
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &app->commandBuffers[imageIndex];
+    VkCommandBuffer submitBuffers[] = {app->audioUploadCommandBuffers[app->currentFrame], drawBuffer};
+    submitInfo.commandBufferCount = 2;
+    submitInfo.pCommandBuffers = submitBuffers;
     
     VkSemaphore signalSemaphores[] = {app->renderFinishedSemaphores[imageIndex]};
     submitInfo.signalSemaphoreCount = 1;
@@ -1057,12 +1351,9 @@ void cleanupSwapChain(DemoApp* app) {
     }
     free(app->swapChainFramebuffers);
     
+    vkFreeCommandBuffers(app->device, app->commandPool, swapChainImageCount * MAX_FRAMES_IN_FLIGHT, app->commandBuffers);
     free(app->commandBuffers);
     
-    vkDestroyPipeline(app->device, app->graphicsPipeline, NULL);
-    vkDestroyPipelineLayout(app->device, app->pipelineLayout, NULL);
-    vkDestroyRenderPass(app->device, app->renderPass, NULL);
-    
     for (uint32_t i = 0; i < swapChainImageCount; i++) {
         vkDestroyImageView(app->device, app->swapChainImageViews[i], NULL);
     }
@@ -1081,12 +1372,22 @@ void recreateSwapChain(DemoApp* app) {
     
     vkDeviceWaitIdle(app->device);
     
+    VkFormat oldFormat = app->swapChainImageFormat;
     cleanupSwapChain(app);
     
     createSwapChain(app);
     createImageViews(app);
-    createRenderPass(app);
-    createGraphicsPipeline(app);
+    
+    // The pipeline only has to follow the render pass, and that only
+    // changes with the surface format
+    if (app->swapChainImageFormat != oldFormat) {
+        printf("Swap chain format changed, rebuilding render pass and pipeline\n");
+        vkDestroyPipeline(app->device, app->graphicsPipeline, NULL);
+        vkDestroyPipelineLayout(app->device, app->pipelineLayout, NULL);
+        vkDestroyRenderPass(app->device, app->renderPass, NULL);
+        createRenderPass(app);
+        createGraphicsPipeline(app);
+    }
     createFramebuffers(app);
     createCommandBuffers(app);
 }
\ No newline at end of file
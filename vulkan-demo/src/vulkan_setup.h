@@ -9,6 +9,11 @@
 #define WIDTH 1920
 #define HEIGHT 1080
 #define MAX_FRAMES_IN_FLIGHT 2
+#define AUDIO_TEXTURE_WIDTH 512
+#define AUDIO_TEXTURE_HEIGHT 2
+#define AUDIO_TEXTURE_SIZE (AUDIO_TEXTURE_WIDTH * AUDIO_TEXTURE_HEIGHT)
+// Guaranteed minimum of maxPushConstantsSize
+#define PUSH_CONSTANT_MAX 128
 
 extern const char* validationLayers[];
 extern const char* deviceExtensions[];
@@ -43,6 +48,16 @@ typedef struct {
     VkDeviceMemory vertexBufferMemory;
     VkBuffer uniformBuffer;
     VkDeviceMemory uniformBufferMemory;
+    void* uniformBufferMapped;
+    VkDeviceSize uniformStride;
+    VkImage audioImage;
+    VkDeviceMemory audioImageMemory;
+    VkImageView audioImageView;
+    VkSampler audioSampler;
+    VkBuffer audioStagingBuffer;
+    VkDeviceMemory audioStagingMemory;
+    void* audioStagingMapped;
+    VkCommandBuffer audioUploadCommandBuffers[MAX_FRAMES_IN_FLIGHT];
     VkDescriptorSetLayout descriptorSetLayout;
     VkDescriptorPool descriptorPool;
     VkDescriptorSet descriptorSet;
@@ -50,6 +65,11 @@ typedef struct {
     VkSemaphore* imageAvailableSemaphores;
     VkSemaphore* renderFinishedSemaphores;
     VkFence* inFlightFences;
+    // DEMO_UNIFORMS=push sends the per-frame header of the uniforms as push
+    // constants, re-recording the frame's draw command buffer each time
+    bool pushConstants;
+    uint32_t pushConstantSize;
+    uint8_t pushConstantData[PUSH_CONSTANT_MAX];
     uint32_t currentFrame;
     bool framebufferResized;
 } DemoApp;
@@ -67,6 +87,7 @@ void createFramebuffers(DemoApp* app);
 void createCommandPool(DemoApp* app);
 void createVertexBuffer(DemoApp* app);
 void createUniformBuffer(DemoApp* app);
+void createAudioTexture(DemoApp* app);
 void createDescriptorSetLayout(DemoApp* app);
 void createDescriptorPool(DemoApp* app);
 void createDescriptorSets(DemoApp* app);
@@ -0,0 +1,173 @@
+// Loopback stand-in for the GNU Rocket editor, for exercising the demo's
+// sync client without an editor installed. Accepts one connection, answers
+// the handshake, keys every track the demo asks for, then pauses, seeks,
+// deletes a key and resumes, logging everything the demo sends back.
+//
+// Usage: rocket_mock_server [port] [seconds]
+// Then run the demo with DEMO_ROCKET_HOST=127.0.0.1
+
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROCKET_SET_KEY 0
+#define ROCKET_DELETE_KEY 1
+#define ROCKET_GET_TRACK 2
+#define ROCKET_SET_ROW 3
+#define ROCKET_PAUSE 4
+
+#define MOCK_MAX_TRACKS 256
+#define MOCK_BUFFER 4096
+// Seconds to wait on a demo that stops reading
+#define MOCK_SEND_TIMEOUT 1.0
+
+static const char client_greeting[] = "hello, synctracker!";
+static const char server_greeting[] = "hello, demo!";
+
+static void write_u32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t read_u32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void send_key(PlatformSocket* client, uint32_t track, uint32_t row, float value, uint8_t type) {
+    uint8_t message[14];
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    message[0] = ROCKET_SET_KEY;
+    write_u32(message + 1, track);
+    write_u32(message + 5, row);
+    write_u32(message + 9, bits);
+    message[13] = type;
+    platform_socket_send(client, message, sizeof(message), MOCK_SEND_TIMEOUT);
+}
+
+static void send_row(PlatformSocket* client, uint32_t row) {
+    uint8_t message[5];
+    message[0] = ROCKET_SET_ROW;
+    write_u32(message + 1, row);
+    platform_socket_send(client, message, sizeof(message), MOCK_SEND_TIMEOUT);
+    printf("-> row %u\n", row);
+}
+
+static void send_pause(PlatformSocket* client, int paused) {
+    uint8_t message[2] = {ROCKET_PAUSE, (uint8_t)paused};
+    platform_socket_send(client, message, sizeof(message), MOCK_SEND_TIMEOUT);
+    printf("-> %s\n", paused ? "pause" : "play");
+}
+
+int main(int argc, char** argv) {
+    uint16_t port = (argc > 1) ? (uint16_t)atoi(argv[1]) : 1338;
+    double seconds = (argc > 2) ? atof(argv[2]) : 5.0;
+    PlatformSocket server;
+    PlatformSocket client;
+    static uint8_t buffer[MOCK_BUFFER];
+    uint32_t fill = 0;
+    uint32_t track_count = 0;
+    uint32_t keyed = 0;
+    uint32_t rows_received = 0;
+    int step = 0;
+    
+    if (platform_socket_listen(&server, port) != 0) {
+        fprintf(stderr, "Cannot listen on port %u\n", port);
+        return 1;
+    }
+    printf("Waiting for the demo on 127.0.0.1:%u\n", port);
+    fflush(stdout);
+    if (platform_socket_accept(&server, &client) != 0) {
+        fprintf(stderr, "Accept failed\n");
+        platform_socket_close(&server);
+        return 1;
+    }
+    
+    char greeting[sizeof(client_greeting) - 1];
+    uint32_t got = 0;
+    while (got < sizeof(greeting)) {
+        int received = platform_socket_recv(&client, greeting + got, sizeof(greeting) - got);
+        if (received <= 0) break;
+        got += (uint32_t)received;
+    }
+    if (got < sizeof(greeting) || memcmp(greeting, client_greeting, sizeof(greeting)) != 0) {
+        fprintf(stderr, "Bad greeting from client\n");
+        platform_socket_close(&client);
+        platform_socket_close(&server);
+        return 1;
+    }
+    platform_socket_send(&client, server_greeting, sizeof(server_greeting) - 1, MOCK_SEND_TIMEOUT);
+    platform_socket_set_blocking(&client, false);
+    printf("Handshake done\n");
+    
+    double start = platform_time_seconds();
+    while (platform_time_seconds() - start < seconds) {
+        int received = platform_socket_recv(&client, buffer + fill, MOCK_BUFFER - fill);
+        if (received < 0) {
+            printf("Demo disconnected\n");
+            break;
+        }
+        fill += (uint32_t)received;
+        
+        uint32_t pos = 0;
+        while (pos < fill) {
+            const uint8_t* message = buffer + pos;
+            if (message[0] == ROCKET_GET_TRACK) {
+                if (fill - pos < 5 || fill - pos < 5 + read_u32(message + 1)) break;
+                uint32_t length = read_u32(message + 1);
+                printf("<- track %u '%.*s'\n", track_count, (int)length, (const char*)message + 5);
+                track_count++;
+                pos += 5 + length;
+            } else if (message[0] == ROCKET_SET_ROW) {
+                if (fill - pos < 5) break;
+                // Rows arrive every frame while playing; only log a few
+                if (rows_received++ % 32 == 0) {
+                    printf("<- row %u\n", read_u32(message + 1));
+                }
+                pos += 5;
+            } else {
+                fprintf(stderr, "Unexpected command %u from demo\n", message[0]);
+                pos = fill;
+            }
+        }
+        fill -= pos;
+        memmove(buffer, buffer + pos, fill);
+        
+        // A ramp on every track: up over a bar, step back, ease out
+        while (keyed < track_count && keyed < MOCK_MAX_TRACKS) {
+            send_key(&client, keyed, 0, 0.0f, 1);
+            send_key(&client, keyed, 16, 1.0f, 0);
+            send_key(&client, keyed, 32, 0.5f, 2);
+            send_key(&client, keyed, 64, 0.0f, 3);
+            keyed++;
+        }
+        
+        double t = platform_time_seconds() - start;
+        if (step == 0 && t > 1.0) {
+            send_pause(&client, 1);
+            send_row(&client, 24);
+            step++;
+        } else if (step == 1 && t > 2.0) {
+            uint8_t message[9];
+            message[0] = ROCKET_DELETE_KEY;
+            write_u32(message + 1, 0);
+            write_u32(message + 5, 16);
+            platform_socket_send(&client, message, sizeof(message), MOCK_SEND_TIMEOUT);
+            printf("-> delete track 0 row 16\n");
+            send_row(&client, 8);
+            step++;
+        } else if (step == 2 && t > 3.0) {
+            send_pause(&client, 0);
+            step++;
+        }
+        fflush(stdout);
+        platform_sleep_ms(5);
+    }
+    
+    platform_socket_close(&client);
+    platform_socket_close(&server);
+    return 0;
+}